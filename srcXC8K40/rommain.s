@@ -33,9 +33,9 @@
 ;  0 0008 - 0 0017   High Priority Interrupt Vector
 ;  0 0018 - 0 0027   Low Priority Interrupt Vector
 ;  0 0030 - 0 07FF   Primary Bootloader (memory protected)
-;  0 0800 - 0 08FF   Program Constants
-;  0 0900 - 0 097F   High Priority Interrupt Service Routine
-;  0 0980 - 0 09FF   Low Priority Interrupt Service Routine
+;  0 0800 - 0 08FF   Program Constants, Monitor Strings
+;  0 0900 - 0 097F   High Priority Interrupt Service Routine, Monitor Strings
+;  0 0980 - 0 09FF   Low Priority Interrupt Service Routine, Monitor Strings
 ;  0 0A00 - 0 1FFF   Application Code
 ;  0 2000 - 0 03FF   ROM Block 0
 ;  0 4000 - 0 7FFF   ROM Block 1
@@ -48,10 +48,24 @@
 ;  
 ; General Purpose Register Usage
 ;  0 00 - 0 2F       Program Variables
-;  0 30 - 0 7F       ROM Configuration Table
-;  0 E0 - 0 FF       71B Address Mapping Table
+;  0 30              MMIO Window Nibble 2
+;  0 70 - 0 75       RAM Device ID Entry (RAMDEV)
+;  0 78 - 0 79       Flash Scrub State (SCRUB)
+;  0 80 - 0 93       Coprocessor State, two copies (COPROC)
+;  0 94 - 0 BE       Telemetry Counters (TELEM)
+;  0 C0 - 0 FF       Extended Variables (XVARS)
 ;  1 00 - 1 FF       Serial Monitor Character Buffer
 ;  2 00 - 2 FF       Flash Write Sector Buffer
+;  3 00 - 3 FF       71B Address Decode Table
+;  4 00 - 4 FF       MMIO Register File
+;  5 00 - 5 FF       Live Monitor Output Ring (LIVEMON)
+;  6 00 - 7 FF       Serial Bridge RX and TX Rings (BRIDGE)
+;  8 00 - 8 47       Slack Telemetry (SLACK)
+;  8 80 - 8 F7       ROM Configuration Table
+;  9 00 - C FF       RAM Device, one nibble per byte (RAMDEV)
+;  D 00 - D FF       Bus Trace Ring (BUSTRACE)
+;  E 00 - E 7F       ROM Page Heat Map (HEATMAP)
+;  E 80 - E 8F       Committed Block CRCs (SCRUB)
 ;  
 ; Special Function Register Usage
 ;  
@@ -117,10 +131,11 @@
 ;          PCREAD or DPREAD command. The address is computed by the LOADPC or
 ;          LOADDP command and s saved after every use to locations PPTR or DPTR.
 ;  FSR0    Used as a scratch register for miscellaneous SRAM accesses.
-;  FSR1    Used by the PCWRITE and DPWRITE functions to write data to the
-;          command buffer, starting at ROMNUM, and holding up to 16 nibbles
-;  FSR2    Points to the Mapping Table MAPTAB, used during the mapping process
-;          from the 20-bit Saturn address to the 17-bit PFM address.
+;  FSR1    Used by the PCWRITE/DPWRITE and MMIO read functions to access the
+;          MMIO register file MIOFILE, one register per nibble
+;  FSR2    Points into the address decode table DECTBL, used during the
+;          mapping process from the 20-bit Saturn address to the 17-bit PFM
+;          address. LOADREG sets FSR2L for every address it reads.
 ;  
 ;  
 ; PIC18F Hardware Operation
@@ -162,18 +177,38 @@
 ;  nibble. This would use a single table entry to encode 16K, 32K or 64K ROMs.
 ;  Either approach is supported, though the multi-chip approach is faster.
 ;  
-;  An 8K ROM image is currently supported in the upper half of PFM Block 0,
-;  address range 0x2000~0x3FFF. This image is enumerated as a 16KB ROM during
-;  bus configuration.
+;  An 8K ROM image can be placed in either half of a PFM block, so a block
+;  holds two of them, and the upper half of PFM Block 0, address range
+;  0x2000~0x3FFF, holds one more. Its table entry has the 8K size te8K in ID
+;  nibble 1, and teLOW set in the Bank byte for the lower half. It is
+;  enumerated as an 8K ROM and only its four 4K nibble pages are mapped. An
+;  older table with a 16K entry for block 0 still has its 8K image mirrored
+;  in the upper half of the 16K window.
+;
+;  The ROM table has 14 entries, so two 8K images in each of the seven blocks
+;  can be resident at once, or 12 with SCRUB, whose block CRCs share the 128
+;  byte config sector with the table and BOOTREC. The table is kept in SRAM
+;  page 8 and only reached through FSR0 and FSR1. EXITINI copies nibble 2 of
+;  the MMIO address to MION2 in page 0 for LOADREG.
+;  
+;  A table entry names its PFM block and nothing checks that blocks are not
+;  named twice, so ROM images that share a chip, such as the Forth hard ROMs,
+;  or two configurations of the same image, can share the block. A shared
+;  chip must be enumerated as a 16K chip of its own, since a 32K or 64K entry
+;  takes the blocks following its first. utils/romdedup.py hashes the images
+;  of a ROM set in 16K chips and lays out the distinct chips in blocks 1..7.
 ;  
 ; ROM Image Access
 ;  When the DP or PC register is loaded with an address, the software constructs
 ;  a pointer into PFM based on the register value. Subsequent reads are done
 ;  using the pointer if the register address is within the range of the ROM's
-;  assigned base address. This is done by using the top five bits of the
-;  register address to look up a value that is used in PFM addressing. If the
-;  value is zero then the register does not address one of the seven 16KB PFM
-;  blocks. Once the PFM pointer is constructed, it is saved across all nibble
+;  assigned base address. This is done by using the top eight bits of the
+;  register address to look up a decode table entry for its 4K nibble page.
+;  The entry holds the PFM address bits of the page and flags for a mapped ROM
+;  page and for the page holding the MMIO window. The lookup costs the same no
+;  matter how many ROMs are configured, and ROMs are placed in the address
+;  space with 4K nibble granularity. Once the PFM pointer is constructed, it
+;  is saved across all nibble
 ;  reads. Importantly, this means the pointer-based reads can cross PFM block
 ;  boundaries, as would be expected with multi-chip ROM images. Boundary
 ;  crossing is not checked for, rather it is assumed ROM content would not
@@ -264,12 +299,423 @@
 ;    its half-cycles merged, resulting in an instruction count of 2~4 + 19. A
 ;    CDn interrupt here could possibly result in TBLPTRU being incorrectly set.
 ;  Addressed Dec. 12, 2020: Reduced to 2~4 + 18. Still tight!
+;  Reduced to 2~4 + 16 by the 4K page decode table.
+;  2~4 + 15 when INITDEV measured a 71B that presents data early. The profile
+;  (TIMPRF) and the STRn period (STRPER) are shown by the monitor STATUS
+;  command. A SLACK build adds 2 IC to it and to the high half of nibble 3,
+;  2~4 + 18, see Slack Telemetry.
 ;  
 ;  - PCREAD/DPREAD routine. The main loop that handles a series of nibble reads
 ;    has its half-cycles merged. Instruction coult is 2~4 + 19/20. A CDn
 ;    interrupt would only cause the next unneeded nibble to be lost or the
 ;    branch to the top of the loop to not be executed.
-;  
+;  Addressed: The loop is now the sequential read engine below. No half-cycle
+;    is merged and the longest one is 2~4 + 10.
+;
+; Enumeration Set Up
+;  The 71B sends its first ID command soon after Din rises, and INITDEV must
+;  be waiting at ENUMROM by then. COMMIT stores the ROM table in the form it
+;  is served, with the ADDR bytes already derived from the flash blocks, and
+;  follows it with a boot record byte. HARDRST copies such a table and is
+;  done, only a table from ROMconfig.inc is still fixed up in HALOOP2. A wake
+;  from sleep keeps the table in SRAM and rebuilds only the decode table.
+;  The bus addresses of the soft ROMs are only known after CONFIGURE, so the
+;  decode table can't be stored.
+;
+;  INITDEV counts the instruction cycles from its entry until it is ready
+;  (ENRDY), and ENLATE counts set ups where a CDn fell before then, which
+;  means a command went by unanswered. The latency from the Din rise to
+;  INITDEV is not included. The monitor STATUS command shows both.
+;
+; Sequential Read Engine
+;  PCREAD and DPREAD share one scheme. The loop is unrolled into an even and an
+;  odd nibble read cycle for every PFM byte, so there is no even/odd test in
+;  the loop. The even cycle only swaps TABLAT to bring the high nibble down,
+;  the odd cycle does the tblrd +* for the next byte. Each cycle stages the
+;  nibble for the next one in CMDLAT right after releasing the bus.
+;
+;  TBLPTR and TABLAT are left live for the register that last ran a burst, as
+;  recorded in PTROWN. A PC READ following a PC READ (or DP after DP) picks up
+;  TBLPTR and the staged nibble where the previous burst stopped. Only when the
+;  dispatch switches between PC and DP is TBLPTR reloaded from PPTR or DPTR.
+;  A LOAD PC or LOAD DP drops ownership for its own register.
+;
+;  The saved copy of TBLPTR is written once per PFM byte, in the low half of
+;  the odd cycle, rather than when switching. A save at the switch would put
+;  the save, the reload and the tblrd into the dummy cycle, 2~4 + 23 IC,
+;  which leaves no margin ahead of the first read cycle.
+;
+;    Read cycle     Before      Engine
+;    even nibble    2~4 + 17    2~4 + 3, 2~4 + 4
+;    odd nibble     2~4 + 18    2~4 + 10, 2~4 + 6
+;    dummy cycle    2~4 + 15    2~4 + 7/16, 2~4 + 4
+;
+;  The low half of the odd cycle is 2~4 + 8 in a SLACK build, which samples
+;  the engines there.
+;
+;  The first nibble is fetched in the low half of the dummy cycle, after its
+;  STRn fall, as before the engine. It can't be fetched any earlier. A LOAD
+;  PC or LOAD DP ends 18~20 IC after the fall of its last address nibble,
+;  20~22 with SLACK, and a dispatched read arrives about 5 IC ahead of the
+;  dummy cycle. A staged nibble kept per register would not help either. The
+;  TBLPTR reload is still needed to go on with the burst, and a movff from
+;  such a byte costs the same 2 IC as the tblrd it replaces.
+;  The fetch is 7 IC when TBLPTR is live and 16 IC when it is reloaded. The
+;  16 IC run past the STRn rise, the POSEDGE then falls through, and the
+;  nibble is staged with 3~5 IC to spare ahead of the first read cycle.
+;  Writing CMDLAT before the first DATAOUT is harmless because the drivers
+;  are still off. Nothing else fits in the dummy cycle, so HEATMAP, TELEM
+;  and BUSTRACE count and record elsewhere.
+;
+;  Any other code that uses TBLPTR or TABLAT must clear PTROWN.
+;
+; MMIO Register File
+;  The MMIO window is 256 nibbles starting at the address stored after ROMDAT,
+;  2C000h by default. LOADREG clears MIOVLD when nibble 2 misses and the
+;  decode entry has dtMIO set for the 4K page, so nibbles 1..0 of the PC or
+;  DP register index the register file MIOFILE in SRAM page 4. Each byte
+;  holds one nibble. PC/DP WRITE stores, and PC/DP READ returns, one register
+;  per STRn cycle for the whole burst. Multi-nibble values are stored low
+;  nibble first, as PEEK$ and POKE order them.
+;
+;    Register   Use
+;    00         ROMNUM, ROM configuration nibble (read at Din rise)
+;    01 - 0F    Command buffer
+;    10         TIMPRF, Saturn timing profile (read only)
+;    11 - 12    STRPER, four STRn periods in IC (read only)
+;    13         ROM profile served from the next Din rise (PROFILE)
+;    14 - 1D    Serial bridge registers (BRIDGE), see below
+;    1E - 1F    Blocks failing the flash scrub (SCRUB), one bit each
+;    20 - FF    Coprocessor registers (COPROC), see below
+;    20 - 73    Telemetry counters (TELEM), see Telemetry Counters
+;    C0 - FF    Serial bridge FIFOs (BRIDGE)
+;
+;  Status registers are refreshed by MIOSTAT when enumeration completes.
+;
+; MMIO Coprocessor
+;  The COPROC build option lets the 71B hand work to the PIC, which is
+;  otherwise counting its idle timeout. The 71B stores the operands, then
+;  the opcode, and polls the opcode register until it reads 0. The Idle task
+;  runs the kernel one short step per pass, so bus commands are answered
+;  as usual while it works.
+;
+;    Register   Use
+;    20         Opcode, cleared when done
+;                 1 CRC-16/X-25, 2 CRC-32 of the block
+;                 3 nibble search, 4 byte search of the pattern in the block
+;                 5 BCD multiply A * B, 6 BCD divide A / B
+;    21         Status, 0 done, 1 bad opcode, block over C0h nibbles or
+;                 quotient digit over 9
+;    22 - 23    Block length in nibbles
+;    24 - 25    Pattern length in nibbles
+;    28 - 2F    CRC, or nibble offset of the match (FFh if none)
+;    30 - 3F    Pattern, or 12 digit mantissa A
+;    40 - FF    Block, or 12 digit mantissa B at 40 - 4B
+;    50 - 67    BCD product, or 13 quotient digits at 50 - 5C
+;
+;  All values are stored low nibble first. The BCD kernels work on the
+;  mantissas only, the 71B handles signs and exponents. The quotient is
+;  A * 10^12 / B truncated, so its top digit is 0 when A < B.
+;
+;  A CDn interrupt abandons the Idle task wherever it is. Each step loads
+;  the kernel state from the committed copy, works on CPWORK and commits to
+;  the other copy by toggling CPSEL, so a step that is cut short is run
+;  again. A step is at most about 450 IC, a multiply column.
+;
+; Serial Bridge
+;  The BRIDGE build option lets the 71B use the serial port while it is on.
+;  The Idle task moves bytes between the UART and 255 byte rings in SRAM
+;  pages 6 and 7, and between the rings and two 16 byte FIFOs in the MMIO
+;  register file that the 71B reads and writes with PEEK$ and POKE.
+;
+;    Register   Use
+;    14         Control, bit 0 bridge on, bit 1 IRQ14 enable (71B writes)
+;    15         RX FIFO head (PIC writes)
+;    16         RX FIFO tail (71B writes)
+;    17         TX FIFO head (71B writes)
+;    18         TX FIFO tail (PIC writes)
+;    1A - 1B    Bytes waiting in the RX ring behind the RX FIFO
+;    1C - 1D    Bytes in the TX ring still to be sent
+;    C0 - DF    RX FIFO, byte n at C0 + 2n, low nibble first
+;    E0 - FF    TX FIFO, byte n at E0 + 2n, low nibble first
+;
+;  A FIFO is empty when head = tail and full when head + 1 = tail, mod 16.
+;  The 71B reads the RX byte at the tail and then advances the tail, and
+;  writes the TX byte at the head and then advances the head. IRQ14 is held
+;  high while the RX FIFO has data and bit 1 of the control register is set.
+;  While the bridge is on and Din is high the serial monitor is not entered.
+;  Once the 71B is turned off the port goes back to the monitor, and the
+;  bridge picks it up again at the next Din rise if it is still turned on.
+;
+;  The UART is polled, not interrupt driven, as a UART interrupt would hold
+;  up a bus command in progress. The Idle task gets time between commands
+;  only, so at most 2 bytes can arrive during a long burst before the
+;  receiver overruns. Reading or writing the UART and counting the byte is
+;  done with GIEH off, which can delay a CDn response by up to 3 IC.
+;
+; Live Monitor
+;  The LIVEMON build option keeps the serial monitor usable while the 71B is
+;  on. The Monitor task turns interrupts off and waits on the serial port, so
+;  without LIVEMON it must only be used with the 71B off. With LIVEMON, while
+;  Din is high the Idle task calls LIVSVC instead, which sends at most one
+;  character from a 255 byte output ring in SRAM page 5 and runs at most one
+;  received character per pass. CDn still preempts it at any point and no
+;  interrupt is ever masked, so bus latency is unchanged.
+;
+;  Only S[TATUS], P[LUG], L[AST], H[ARD] and ? are taken this way. Escape
+;  cancels a pending argument. PLUG, LAST and HARD take at most one argument
+;  character and change the ROM table in SRAM, which takes effect the next
+;  time the 71B is turned on, as it does from the Monitor task. R[OM] also
+;  edits the ROM table in SRAM, but its dialog of up to five arguments is not
+;  split into slices, so it needs the 71B off like ERASE, IMAGE, COMMIT and
+;  EXECUTE, which write flash and stall the CPU.
+;
+;  A received character is taken with a single movff from RC1REG into LMCHR,
+;  after the output ring index and the pending command were recorded, and
+;  it is only released after it was fully handled. Its reply is built past
+;  LMIN and committed with one write to LMIN, so a pass cut short by CDn runs
+;  the same character again to the same result. A character sent to the UART
+;  just before a CDn can be sent twice.
+;
+; HALT Wake
+;  The HALTWAKE build option drives the Saturn HALT line (Halt71) high while
+;  the PIC is asleep with the 71B turned off, and from a power on reset with
+;  the 71B turned off until the first pass through INITDEV. INITDEV releases
+;  it once INITVAR and INITTAB have rebuilt the tables and HFINTOSC reports
+;  ready, so the first bus cycles of the 71B after it is turned on are
+;  answered from good tables. That is also what a takeover ROM needs, which
+;  must be read from the very first bus cycle.
+;
+;  HALT is never asserted while Din is high. A 71B that is on but idle has
+;  configured the module already, and stopping its CPU would also stop the
+;  bus activity that wakes the PIC. With HALTWAKE the Idle task goes to sleep
+;  after about 10 seconds instead of 2.5 minutes while the 71B is off.
+;
+; Power Management
+;  Without the POWERMGT build option the Idle task busy-waits at full speed
+;  and goes to Sleep after about 2.5 minutes without a bus command. With it:
+;
+;    State            PIC                        Left on
+;    71B busy         Full speed                 Everything
+;    71B SHUTDOWN     Idle mode, CPU stopped     CDn straight into the ISR
+;    71B off          Sleep                      Din rise through INITDEV
+;
+;  The Idle task does not Doze between commands. With Recover On Interrupt the
+;  CPU only takes the CDn interrupt at the end of its current Doze cycle, up
+;  to 256 IC at 1:256, where a command allows about 13 IC, and even 1:2 would
+;  add to the dispatch latency of every command. The SHUTDOWN command naps in
+;  Idle mode, where the clock keeps running and the next CDn is answered as
+;  usual. A nap wakes on a Din rise, and every 256 seconds on Timer0 to go to
+;  Sleep once Din has fallen. Sleep also wakes every 256 seconds, only to
+;  count the Timer0 period. SHUTDOWN with Din already low goes to Sleep at
+;  once.
+;
+;  Timer0 counts seconds from LFINTOSC in all three states. After PMTMO
+;  seconds without a bus command the Idle task naps or sleeps as after
+;  SHUTDOWN, 0 turns the timeout off. PMTMO is loaded at reset from data
+;  EEPROM 200h and set with the TIMEOUT monitor command, an erased EEPROM
+;  gives 255 seconds. The Idle task adds each second to PMON (Din high),
+;  PMOFF (Din low) or PMSLP (napping or asleep), and PMWAKE keeps the
+;  instruction cycles from the last wake from Sleep until INITDEV started.
+;  Before a nap the Timer1 gate is armed for one pulse on CDn, so Timer1
+;  counts from the CDn fall that ends the nap until ISVHI stops it, and
+;  IDLE keeps the low byte in PMNAPW. FASTISR builds do not time the nap,
+;  CMDVEC has no cycle to spare. STATUS shows them all. A second that a CDn
+;  cuts short is lost.
+;
+;  Compare PMNAPW with the 3/4 + 2 + 5 IC an awake ISVHI takes to the same
+;  point (see ISVHI) on the oldest and the newest 71B in use before turning
+;  this mode on.
+;
+; Bus Trace
+;  The BUSTRACE build option keeps the last 64 bus commands in TRRING, SRAM
+;  page D, four bytes per record: the command nibble and nibble 4 of the PC
+;  or DP register, nibbles 3..0 of the register and the high byte of Timer3,
+;  which counts instruction cycles, so one count is 16 us. TRIDX is the next
+;  record to write and commits each record with a single write.
+;
+;  Read bursts never return to the Idle task, and the dummy cycle ahead of
+;  the first nibble has no time to spare when TBLPTR is reloaded, so the read
+;  engines record nothing. A LOAD PC or LOAD DP is recorded in two parts
+;  instead. TROPEN writes the command and the time stamp ahead of the first
+;  address nibble, 12 IC, and commits the record. TRADDR adds the address
+;  after LOADREG, 6 IC, which can end the LOAD up to 3 IC after the dummy
+;  cycle started, still well ahead of the first read cycle. A LOAD cut short
+;  by CDn keeps the address bytes of an older record. Commands that end in
+;  the Idle task are recorded there by TRIDLE, with the DP register for odd
+;  commands and the PC register for the others. A PC/DP READ burst that goes
+;  on from the last address is only recorded when it ends there. The DUMP
+;  monitor command lists the ring, oldest record first.
+;
+; Slack Telemetry
+;  The SLACK build option measures how much of a half-cycle is used at five
+;  sites: the nibble 3 high half-cycle and the end of LOADREG (slLDR3,
+;  slLDR4), the longest half-cycle of the PC and DP read engines (slPCR,
+;  slDPR) and the command half-cycle of the ID response (slID). Timer2 counts
+;  instruction cycles and is reset by either edge of STRn through T2INPPS, so
+;  TMR2 is the time since the last edge, late by the input synchronizer. The
+;  SLPROBE macro keeps it as the latest sample of its site in SLKBUF, for
+;  2 IC more in that half-cycle.
+;
+;  The probes shift the margins they report. At slLDR3 and slPCR/slDPR the
+;  probe comes before the spin-wait that ends the half-cycle, so a SLACK build
+;  uses 2 IC more of it than a normal build, and at slLDR4 LOADREG ends 2 IC
+;  later, which the caller's next half-cycle absorbs. The largest value at a
+;  site is therefore the one of the SLACK build itself. A normal build has
+;  2 IC more slack than MARGIN shows. The cycle counts in the code give both.
+;
+;  The Idle task folds each new sample into the smallest and largest value
+;  of the site and a histogram of eight 2 IC buckets, the last one holding
+;  14 IC and more. A sample is taken before it is counted, so a CDn can only
+;  lose it. Samples that come while the Idle task is not running replace
+;  each other, so the histogram is a sampling of the bus, not a count.
+;  The MARGIN monitor command lists the sites with STRPER/8, the half-cycle
+;  measured during enumeration, and starts over. The slack of a site is the
+;  half-cycle less its largest value.
+;
+; Heat Map
+;  The HEATMAP build option counts the LOAD PC and LOAD DP commands into each
+;  2K PFM page, which is 4K nibbles of a ROM image, in 64 16-bit counters in
+;  HEATBL. The HEATCNT macro finds the counter from the decode entry of the
+;  register, rotated right so that page bits 7..3 and dtU index two bytes.
+;
+;  The dummy cycle of a read burst has no time to spare when TBLPTR is
+;  reloaded, which a LOAD always does, so HEATCNT runs at the start of LOAD
+;  PC and LOAD DP instead, ahead of the first address nibble, 3 or 9~10 IC.
+;  The decode entry is then still the one of the previous LOAD of the same
+;  register, so a LOAD is counted when the next one replaces it. A LOAD that
+;  missed the ROM pages is not counted, nor are PC/DP READ bursts that go on
+;  from the last address, and a counter wraps after 65535 LOADs.
+;
+;  The USAGE monitor command lists the counters as one line per 16K PFM
+;  block, eight 2K pages each, and starts over. Blocks 1..7 hold the ROM
+;  images, see the ROM LIST, and a 32K image spans two blocks.
+;
+; Telemetry Counters
+;  The TELEM build option keeps 16-bit counters in page 0 that a 71B program
+;  can read with PEEK$ from the MMIO register file, each as four registers,
+;  low nibble first. They start at 0 on a reset, live through Sleep, and wrap.
+;
+;    Register   Count
+;    20 - 5F    Commands dispatched, four registers per command 0 - F
+;    60 - 63    LOAD PC and LOAD DP answered from a ROM or MMIO page
+;    64 - 67    LOAD PC and LOAD DP not answered (miss)
+;    68 - 6B    CONFIGURE commands taken during enumeration
+;    6C - 6F    Wakes from Sleep
+;    70 - 73    Serial monitor receive overruns
+;
+;  A command is counted where its handler has time to spare. The dummy cycle
+;  of a read burst has none when TBLPTR is reloaded, so PC/DP READ are
+;  counted by TLINC on entry, ahead of the dummy cycle, and LOAD PC/DP ahead
+;  of the first address nibble, 2~3 IC each, after which a LOAD skips the
+;  PC/DP READ count. An MMIO write is counted by TLINC ahead of its first
+;  sample. Any other command is counted by TLIDLE when it gets to the Idle
+;  task, which sets CMD to 0FFh so that it is counted once. A LOAD that gets
+;  there was not answered and is a miss. The hits are the LOAD PC and LOAD
+;  DP counts less the misses.
+;
+;  TLSHOW copies one counter to its registers on each pass of the Idle loop.
+;  A copy cut short by CDn is made again, and TLIDX is committed with a
+;  single write. Registers 20 - 73 are written over, so TELEM leaves out
+;  COPROC, and it leaves out RAMDEV, whose write bursts have no spare cycle
+;  ahead of the first sample. HEATMAP and BUSTRACE need the same time ahead
+;  of the address in a LOAD and are left out as well.
+;
+; Flash Scrub
+;  The SCRUB build option checks the PFM blocks holding the ROM images in the
+;  background. COMMIT runs the CRC-16 of blocks 0..7, block 0 being its half
+;  from 2000h, and stores the eight CRCs after the boot record. HARDRST copies
+;  them to SCREF, and without a boot record the scrub stays off.
+;
+;  The CRC module is fed by the memory scanner in Peek mode, which only takes
+;  PFM cycles the CPU leaves unused, such as the second cycle of a branch in
+;  a spin-wait, so a bus command is never held up and nothing needs to be
+;  stopped when CDn falls. SCSVC, called on each pass of the Idle loop, starts
+;  the scan of the block in SCST and commits scRUN, or when the scan and the
+;  CRC are done compares the CRC with SCREF, updates the block's bit in SCBAD
+;  and commits the next block. A pass cut short by CDn is made again, and
+;  SCGO stops a scan under way before it starts one, so a block is never
+;  compared against a partial CRC. A nap or sleep starts the block over.
+;
+;  SCBAD is shown by STATUS and kept in MMIO registers 1E - 1F. A block that
+;  was erased or written with IMAGE shows as failing until the next COMMIT.
+;
+; SPI Library
+;  The SPILIB build option keeps a library of ROM images in a SPI flash such
+;  as a W25Q32 on Port C, driven by the MSSP as master at Fosc/4 (16 MHz), CS
+;  on RC2, SDO on RC1, SCK on RC3 and SDI on RC4. The flash is cut into 16K
+;  byte library slots 00 - FF, 4M bytes for all 256. BACKUP copies a PIC
+;  block 1..7 to a slot, erasing its four 4K sectors and programming it in
+;  256 byte pages. FETCH copies a slot back with one sequential read, a 128
+;  byte PFM sector at a time through SECTBUF. Both need the 71B off, as the
+;  other flash commands do, and FETCH is followed by ROM or COMMIT like IMAGE.
+;
+;  The library is a backup and exchange store only. The 71B is always served
+;  from the PIC blocks, so putting a library image in use takes a FETCH of a
+;  few seconds and a ROM or COMMIT, with the 71B off.
+;
+; ROM Profiles
+;  The PROFILE build option keeps up to eight complete ROM tables in data
+;  EEPROM, 80h bytes each from 000h, laid out as the config sector: the
+;  NROMS entries as they are served and the MMIO entry, then BOOTREC once
+;  the profile was saved. The KEEP monitor command saves the table in SRAM as
+;  profile 1..8. A 71B program POKEs the profile number into MMIO register 13
+;  and turns the 71B off and on again. POKE 0 goes back to the table in the
+;  config sector. Nothing is written to flash and no power cycle of the PIC
+;  is needed.
+;
+;  PFSVC, called on each pass of the Idle loop, sees the register differ
+;  from PFCUR, the profile in SRAM, and commits the request to PFREQ when the
+;  profile was saved, or else puts PFCUR back into the register. It then
+;  copies one byte per pass into ROMDAT, so the table is ready well before
+;  the next Din rise, and INITDEV finishes a copy still under way. The MMIO
+;  entry is saved but not copied back. Each EEPROM read keeps interrupts off for
+;  3 IC while NVMREG points away from Program Flash Memory. PFIDX is
+;  committed after its byte, so a pass cut short by CDn copies it again.
+;
+;  Profile 0 is the table loaded from flash at reset, which COMMIT still
+;  writes. It is read with tblrd, and a table from ROMconfig.inc that COMMIT
+;  never wrote gets its ADDR bytes from HABUILD once copied. ROM table edits
+;  in the monitor are kept in SRAM only until KEEP or COMMIT, and a profile
+;  is loaded again only after another one was.
+;
+; RAM Device
+;  The RAMDEV build option adds a 1K nibble RAM module. Its ID entry RAMDAT is
+;  enumerated ahead of the ROM table, ID nibble 1 = 0Fh for 1K nibbles and
+;  nibble 3 = 0 for RAM. The 4K page it is configured into gets dtRAM in its
+;  decode entry without dtROM, and RAMN2 keeps bits 3..2 of nibble 2 of the
+;  base address, as the RAM covers one quarter of the page. Bits 1..0 of
+;  nibble 2 pick one of the SRAM pages 9..C and nibbles 1..0 the byte in it.
+;
+;  PC/DP READ and WRITE bursts run a loop like the MMIO register file, with
+;  FSR1 walking the SRAM copy and the low byte of the register carried into
+;  nibble 2. A burst that runs past the last nibble of the RAM stops there:
+;  reads release the bus after that nibble and writes no longer store, and
+;  both return to the Idle task, so the rest of the burst finds no device as
+;  on a real module. The pointer and range check take 10 IC, so reads stage
+;  the first nibble in the high half of the dummy cycle, and writes store the
+;  first nibble late in the high half of the first cycle, 2~4 + 18.
+;
+;  The contents are kept in data EEPROM 000h-1FFh, two nibbles per byte, low
+;  nibble first. HARDRST reloads them. A write sets rfDIRTY in RAMFLG and the
+;  SHUTDOWN command starts a write back that the Idle task performs one byte
+;  per pass, skipping bytes that are unchanged. Interrupts stay enabled, so a
+;  71B that wakes during the two seconds the write back takes is answered on
+;  time. Both ISRs set NVMREG back to Program Flash Memory first, which costs
+;  one IC of CDn latency, and an EEPROM unlock sequence that a CDn cuts in two
+;  simply does not start the write, so the byte is written on the next pass.
+;
+; Bus Drivers
+;  The PC/DP READ loops switch the bus output drivers on at every STRn fall
+;  and off at every STRn rise. Letting the Configurable Logic Cells switch
+;  them on the strobe edges was looked at. A CLC or any other peripheral
+;  routed through PPS can only drive the pin value, never its TRIS bit, so a
+;  CLC output on the bus would drive zeros instead of releasing the bus for
+;  the command nibble. Holding the drivers in firmware for a whole burst does
+;  not work either. The firmware can't tell which read cycle is the last one
+;  before CDn falls, so the drivers would still be on when STRn falls for the
+;  command cycle and would fight the command nibble.
+;
 ; User Interaction
 ;  When first powered on the software does not enumerate a ROM image. If a hard
 ;  configured ROM image is stored, it will always respond to a probe of its
@@ -290,10 +736,130 @@
 ; If using an external bootloader usch as the one in AN851 or AN1310, define
 ; both XTRNBOOT and SERMON.
 ; If an internal serial monitor is part of the build, define SERMON.
-; 
-;*******************************************************************************    
+; If the CDn interrupt should read the command and jump to DISPATCH without
+; returning, define FASTISR. Without XTRNBOOT this code sits on the hardware
+; vector. See the High Priority Interrupt Service Routine below.
+; If a 1K nibble RAM module kept in data EEPROM should be enumerated ahead of
+; the ROM images, define RAMDEV. See RAM Device above.
+; If the Idle task should run CRC, search and BCD kernels requested through
+; the MMIO register file, define COPROC. See MMIO Coprocessor above.
+; If the 71B should reach the serial port through FIFOs in the MMIO register
+; file, define BRIDGE, which needs SERMON. See Serial Bridge above.
+; If the Saturn should be held with HALT while the PIC wakes from sleep and
+; builds its tables, define HALTWAKE. See HALT Wake above.
+; If the PIC should nap on SHUTDOWN and sleep on an idle timeout kept in
+; data EEPROM, define POWERMGT. See Power Management
+; above.
+; If the serial monitor should take ROM table commands while the 71B is on,
+; define LIVEMON, which needs SERMON. See Live Monitor above.
+; If the last 64 bus commands should be recorded for the DUMP monitor command,
+; define BUSTRACE, which needs SERMON. See Bus Trace above.
+; If the time used in the tightest half-cycles should be measured for the
+; MARGIN monitor command, define SLACK, which needs SERMON. See Slack
+; Telemetry above.
+; If the LOAD PC and LOAD DP commands into each ROM page should be counted for
+; the USAGE monitor command, define HEATMAP, which needs SERMON. See Heat Map
+; above.
+; If the 71B should read command and event counters from the MMIO register
+; file, define TELEM. See Telemetry Counters above.
+; If the ROM images should be checked in the background against CRCs taken by
+; COMMIT, define SCRUB. See Flash Scrub above.
+; If ROM images should be kept in a SPI flash on Port C and moved to and from
+; the PIC blocks with the BACKUP and FETCH monitor commands, define SPILIB,
+; which needs SERMON. See SPI Library above.
+; If whole ROM tables should be kept as profiles in data EEPROM and picked by
+; the 71B through the MMIO register file, define PROFILE, which needs SERMON
+; to save them. See ROM Profiles above.
+; COPROC does not fit below the ROM images together with RAMDEV or BRIDGE,
+; nor does LIVEMON together with RAMDEV, COPROC, BRIDGE or PROFILE and TELEM
+; or SCRUB, nor POWERMGT together with RAMDEV, COPROC, BRIDGE or LIVEMON, nor
+; BUSTRACE together with COPROC, LIVEMON or POWERMGT, nor SLACK together with
+; RAMDEV, COPROC, LIVEMON or POWERMGT, nor HEATMAP together with COPROC or
+; both SLACK and BRIDGE, nor TELEM together with both SLACK and BRIDGE, nor
+; SCRUB together with RAMDEV, COPROC, BRIDGE, POWERMGT or SLACK, SPILIB only
+; fits with FASTISR, HALTWAKE and LIVEMON, and PROFILE does not fit together
+; with RAMDEV, COPROC, POWERMGT or SPILIB.
+;
+;*******************************************************************************
 #define XTRNBOOT
 #define SERMON
+;#define FASTISR
+;#define RAMDEV
+;#define COPROC
+;#define BRIDGE
+;#define LIVEMON
+;#define HALTWAKE
+;#define POWERMGT
+;#define BUSTRACE
+;#define SLACK
+;#define HEATMAP
+;#define TELEM
+;#define SCRUB
+;#define SPILIB
+;#define PROFILE
+#if defined(COPROC) && (defined(RAMDEV) || defined(BRIDGE))
+#error "COPROC with RAMDEV or BRIDGE overflows the application code space"
+#endif
+#if defined(BRIDGE) && !defined(SERMON)
+#error "BRIDGE needs the serial port set up by SERMON"
+#endif
+#if defined(LIVEMON) && (defined(RAMDEV) || defined(COPROC) || defined(BRIDGE) || (defined(PROFILE) && (defined(TELEM) || defined(SCRUB))))
+#error "LIVEMON with RAMDEV, COPROC, BRIDGE or PROFILE and TELEM or SCRUB overflows the application code space"
+#endif
+#if defined(POWERMGT) && (defined(RAMDEV) || defined(COPROC) || defined(BRIDGE) || defined(LIVEMON))
+#error "POWERMGT with RAMDEV, COPROC, BRIDGE or LIVEMON overflows the application code space"
+#endif
+#if defined(LIVEMON) && !defined(SERMON)
+#error "LIVEMON needs the serial monitor built with SERMON"
+#endif
+#if defined(BUSTRACE) && (defined(COPROC) || defined(LIVEMON) || defined(POWERMGT))
+#error "BUSTRACE with COPROC, LIVEMON or POWERMGT overflows the application code space"
+#endif
+#if defined(BUSTRACE) && !defined(SERMON)
+#error "BUSTRACE needs the serial monitor built with SERMON"
+#endif
+#if defined(SLACK) && (defined(RAMDEV) || defined(COPROC) || defined(LIVEMON) || defined(POWERMGT))
+#error "SLACK with RAMDEV, COPROC, LIVEMON or POWERMGT overflows the application code space"
+#endif
+#if defined(SLACK) && !defined(SERMON)
+#error "SLACK needs the serial monitor built with SERMON"
+#endif
+#if defined(HEATMAP) && defined(BUSTRACE)
+#error "HEATMAP and BUSTRACE share the time ahead of the address in LOAD PC and LOAD DP"
+#endif
+#if defined(HEATMAP) && (defined(COPROC) || (defined(SLACK) && defined(BRIDGE)))
+#error "HEATMAP with COPROC or SLACK and BRIDGE overflows the application code space"
+#endif
+#if defined(HEATMAP) && !defined(SERMON)
+#error "HEATMAP needs the serial monitor built with SERMON"
+#endif
+#if defined(TELEM) && (defined(RAMDEV) || defined(COPROC))
+#error "TELEM counters overlap the COPROC registers, RAMDEV writes have no spare cycle"
+#endif
+#if defined(TELEM) && defined(SLACK) && defined(BRIDGE)
+#error "TELEM with SLACK and BRIDGE overflows the application code space"
+#endif
+#if defined(TELEM) && (defined(HEATMAP) || defined(BUSTRACE))
+#error "TELEM, HEATMAP and BUSTRACE share the time ahead of the address in LOAD PC and LOAD DP"
+#endif
+#if defined(SCRUB) && (defined(RAMDEV) || defined(COPROC) || defined(BRIDGE) || defined(POWERMGT) || defined(SLACK))
+#error "SCRUB with RAMDEV, COPROC, BRIDGE, POWERMGT or SLACK overflows the application code space"
+#endif
+#if defined(SPILIB) && (defined(RAMDEV) || defined(COPROC) || defined(BRIDGE) || defined(POWERMGT))
+#error "SPILIB with RAMDEV, COPROC, BRIDGE or POWERMGT overflows the application code space"
+#endif
+#if defined(SPILIB) && (defined(BUSTRACE) || defined(SLACK) || defined(HEATMAP) || defined(TELEM) || defined(SCRUB))
+#error "SPILIB with BUSTRACE, SLACK, HEATMAP, TELEM or SCRUB overflows the application code space"
+#endif
+#if defined(SPILIB) && !defined(SERMON)
+#error "SPILIB needs the serial monitor built with SERMON"
+#endif
+#if defined(PROFILE) && (defined(RAMDEV) || defined(COPROC) || defined(POWERMGT) || defined(SPILIB))
+#error "PROFILE with RAMDEV, COPROC, POWERMGT or SPILIB overflows the application code space"
+#endif
+#if defined(PROFILE) && !defined(SERMON)
+#error "PROFILE needs the serial monitor built with SERMON"
+#endif
 
 ;#include "p18f27k42.inc"
 
@@ -337,25 +903,106 @@ teID5		EQU 0x04
 teFLAG		EQU 0x05
 teADDR		EQU 0x06
 teBANK		EQU 0x07
+te8K		EQU 0x0b
 te16K		EQU 0x0a
 te32K		EQU 0x09
 te64K		EQU 0x08
 teEOM		EQU 0x03
 teLAST		EQU 0x00
 teHARD		EQU 0x01
+teLOW		EQU 0x03
 
     ; Constants associated with ROM configuration nibble ROMNUM
 cfMAIN		EQU 0
 cfHIDDEN	EQU 1
 
-    ; 7 ROMs (plus add one for MMIO address)
-NROMS		EQU 0x7
+    ; 14 ROMs (plus add one for MMIO address). The config sector holds the
+    ; table, BOOTREC and with SCRUB the 16 bytes of block CRCs in 128 bytes,
+    ; (NROMS+1)*ROMLEN+1+16 leaves room for 12 ROMs with SCRUB.
+#ifdef  SCRUB
+NROMS		EQU 0xc
+#else
+NROMS		EQU 0xe
+#endif
     ;; ROMLEN MUST BE EVEN!
 ROMLEN		EQU 0x8
+    ; Boot record COMMIT writes after the ROM table, erased flash reads 0FFh
+BOOTREC		EQU 0xB0
     ; The table offset to first of two Hard ROM slots
-HRDSLOT		EQU 0x5
-    ; The mask for the MMIO address (size in nibbles of IO block)
-MMIOMASK	EQU 0x0f
+HRDSLOT		EQU NROMS-2
+    ; MMIO register file, first read-only status register
+mrSTAT		EQU 0x10
+    ; MMIO register file, coprocessor registers
+mrOP		EQU 0x20
+mrCST		EQU 0x21
+mrLEN		EQU 0x22
+mrPLEN		EQU 0x24
+mrRES		EQU 0x28
+mrA		EQU 0x30
+mrBLK		EQU 0x40
+mrPROD		EQU 0x50
+    ; Coprocessor opcodes and committed state length
+cpCRC16		EQU 0x1
+cpCRC32		EQU 0x2
+cpFINDN		EQU 0x3
+cpFINDB		EQU 0x4
+cpMUL		EQU 0x5
+cpDIV		EQU 0x6
+CPLEN		EQU 0xa
+    ; MMIO register file, serial bridge registers and FIFOs
+mbCTL		EQU 0x14
+mbRXH		EQU 0x15
+mbRXT		EQU 0x16
+mbTXH		EQU 0x17
+mbTXT		EQU 0x18
+mbRXN		EQU 0x1a
+mbTXN		EQU 0x1c
+mbRXF		EQU 0xc0
+mbTXF		EQU 0xe0
+    ; MMIO register file, telemetry counters and how many there are
+mrTEL		EQU 0x20
+TLNUM		EQU 0x15
+    ; MMIO register file, blocks failing the flash scrub
+mrSCRUB		EQU 0x1e
+    ; MMIO register file, ROM profile to serve
+mrPROF		EQU 0x13
+    ; SCST bits, bits 2..0 hold the block, scan started, no CRCs committed
+scRUN		EQU 3
+scOFF		EQU 7
+    ; Decode table entry bits, TBLPTRH bits 7..3 are kept in bits 7..3
+dtROM		EQU 0
+dtMIO		EQU 1
+dtU		EQU 2
+    ; PTROWN bits, TBLPTR/TABLAT are live for the PC or DP read engine
+ownPC		EQU 0
+ownDP		EQU 1
+    ; TIMPRF bits, Saturn timing profile measured during enumeration
+tpFAST		EQU 0
+tpLATE		EQU 1
+    ; Early command samples needed before the fast profile is trusted
+TIMMIN		EQU 0x4
+    ; RAM device, ID nibble 1 for 1K nibbles and flag bit of its ID entry
+teRAM1K		EQU 0x0f
+teRAM		EQU 0x02
+    ; Decode entry of the RAM device page, dtU without dtROM
+dtRAM		EQU dtU
+    ; RAMFLG bits, RAM device differs from, and is being saved to, EEPROM
+rfDIRTY		EQU 0
+rfSAVE		EQU 1
+    ; PMFLG bits, seconds go to PMSLP, wake latency still to be recorded
+pmSLEEP		EQU 0
+pmWAKE		EQU 1
+    ; Data EEPROM byte holding the idle timeout in seconds
+PMEEADR		EQU 0x200
+    ; ROM table profiles, 80h bytes each from data EEPROM 000h
+NPROF		EQU 0x8
+    ; Slack telemetry sites, see SLPROBE
+slLDR3		EQU 0x0
+slLDR4		EQU 0x1
+slPCR		EQU 0x2
+slDPR		EQU 0x3
+slID		EQU 0x4
+SLSITES		EQU 0x5
 
 ; EEPROM memory can be read using NVM registers or TBLPTR
 ; ORG 0x310000
@@ -366,6 +1013,8 @@ MMIOMASK	EQU 0x0f
 ; Variable Declarations
 ; ALL variables are in Bank 0
 ; For Access Bank addressing, variables must be in the range of 00 - 5Fh
+; The Access Bank is full, later variables are placed at XVARS and need the
+; BSR set to 0 (banksel CMD), which holds for all bus command processing.
 ; 
 ; Access Bank SPR's used in this program
 ; 
@@ -375,7 +1024,7 @@ MMIOMASK	EQU 0x0f
 ;*******************************************************************************
 PSECT   udata_acs
 PUBLIC	CMD, RDY, ARANGE, DRANGE, PRANGE, MIOVLD, MIOADR, ROMNUM, CMDBUF
-PUBLIC  ROMDAT, MMIO, MAPTBL
+PUBLIC  ROMDAT, MMIO, DECTBL, MIOFILE
 CMD:      DS      1                   ; Command register (nibble)
 RDY:      DS      1                   ; Module ready flag
 ADDR:     DS      3                   ; Configuration address (20 bits, 3 bytes)
@@ -384,30 +1033,100 @@ DPREG:    DS      3                   ; DP register (20 bits, 3 bytes)
 ROMBANK:  DS      1                   ; Which of 8 PFM banks is active ROM
 ROMSIZ:   DS      1                   ; Temporary used in initialization
 MAPVAL:   DS      1                   ; Temporary used in initialization
-ARANGE:   DS      1                   ; Address range bits 19 downto 15
-DRANGE:   DS      1                   ; DP register range bits 19 downto 15
-PRANGE:   DS      1                   ; PC register range bits 19 downto 15
+ARANGE:   DS      1                   ; Address range bits 19 downto 12
+DRANGE:   DS      1                   ; Decode table entry for DP register
+PRANGE:   DS      1                   ; Decode table entry for PC register
 CNTR:     DS      1                   ; General use counter
 APTR:     DS      3                   ; Not used except as scratch
 DPTR:     DS      3                   ; TBLPTR for DP register
 PPTR:     DS      3                   ; TBLPTR for PC register
 IDSENT:   DS      1                   ; Flag that ID has been sent, ignore ID cmd
 TEMP:     DS      1                   ; Temporary variable
-MIOVLD:   DS      1                   ; Address is in MMIO address range
+MIOVLD:   DS      1                   ; Address nibble 2 matches MMIO window
 MIOADR:   DS      1                   ; MMIO register to read/write
 ADIGIT:   DS      1                   ; Temporary location for a digit (ASCII 0-8)
-ROMNUM:   DS      1                   ; ROM Configuration nibble @ 2C000h
-CMDBUF:   DS      1                   ; MMIO (16 bytes)/Command Buffer (6 bytes)
+CMDBUF:   DS      1                   ; Monitor Command Buffer (6 bytes)
 
-ROMDAT    EQU     0x30                ; ROM configuration initialized on start
+ROMDAT    EQU     0x0880              ; ROM configuration initialized on start
         ; 5 nibble address of Memory-mapped I/O device
 ;MMIO   EQU     ROMDAT+ROMLEN*NROMS !This was computed as 0x188!!!
 MMIO   EQU     ROMDAT+(ROMLEN*NROMS)  ; No operator precedence
-
-MAPTBL  EQU     0xe0                ; Top 32 registers of page 0
+MION2     EQU     0x30                ; MMIO nibble 2 for LOADREG in page 0
+RAMDAT    EQU     0x70                ; ID entry of the RAM device
+SCST      EQU     0x78                ; Flash scrub block and state
+SCBAD     EQU     0x79                ; Blocks failing the flash scrub
+CPSTA     EQU     0x80                ; Coprocessor state, two copies
+TLCNT     EQU     0x94                ; Telemetry, one counter per command
+TLHIT     EQU     TLCNT+0x20          ; LOADs answered, copied from counts
+TLMISS    EQU     TLCNT+0x22          ; LOADs not answered
+TLCFG     EQU     TLCNT+0x24          ; CONFIGURE commands taken
+TLWAKE    EQU     TLCNT+0x26          ; Wakes from Sleep
+TLOERR    EQU     TLCNT+0x28          ; Serial monitor receive overruns
+TLIDX     EQU     TLCNT+0x2a          ; Next counter TLSHOW copies
+
+
+        ; Extended variables, banked access to page 0 (BSR = 0)
+XVARS   EQU     0xc0
+PTROWN  EQU     XVARS               ; Register whose read burst owns TBLPTR
+TIMPRF  EQU     XVARS+1             ; Saturn timing profile flags
+TIMCNT  EQU     XVARS+2             ; Early command samples taken
+STRPER  EQU     XVARS+3             ; Four STRn periods in instruction cycles
+RAMN2   EQU     XVARS+4             ; RAM device base nibble 2, bits 3..2
+RAMFLG  EQU     XVARS+5             ; RAM device EEPROM state
+RAMIDX  EQU     XVARS+6             ; Next EEPROM byte to save (2 bytes)
+CPSEL   EQU     XVARS+8             ; Committed coprocessor state copy
+RXIN    EQU     XVARS+9             ; Serial bridge ring indexes
+RXOUT   EQU     XVARS+0xa
+TXIN    EQU     XVARS+0xb
+TXOUT   EQU     XVARS+0xc
+PFCUR   EQU     XVARS+0xd           ; ROM profile in ROMDAT, 0 from flash
+PFREQ   EQU     XVARS+0xe           ; 80h + ROM profile being copied, 0 none
+PFIDX   EQU     XVARS+0xf           ; Next ROMDAT byte to copy
+CPWORK  EQU     XVARS+0x10          ; Coprocessor state being worked on
+CPOP    EQU     CPWORK              ; Opcode under way
+CPIDX   EQU     CPWORK+1            ; Step index
+CPACC   EQU     CPWORK+2            ; Kernel state (8 bytes)
+CPQ     EQU     CPACC+7             ; Quotient digit being counted
+CPS     EQU     CPWORK+CPLEN        ; Scratch, not committed (2 bytes)
+CPJ     EQU     CPWORK+CPLEN+2
+CPREM   EQU     CPWORK+CPLEN+3
+CPBC    EQU     XVARS+0x20          ; Nine's complement of the divisor
+LMCHR   EQU     XVARS+0x28          ; Live monitor character being handled
+LMCMD   EQU     XVARS+0x29          ; Command waiting for its argument
+LMPREV  EQU     XVARS+0x2a          ; LMCMD when LMCHR was taken
+LMTAG   EQU     XVARS+0x2b          ; LMIN when LMCHR was taken
+LMIN    EQU     XVARS+0x2c          ; Live monitor output ring indexes
+LMOUT   EQU     XVARS+0x2d
+LMEND   EQU     XVARS+0x2e          ; End of the reply being built
+PMFLG   EQU     XVARS+0x30          ; Power management flags
+PMTMO   EQU     XVARS+0x31          ; Idle timeout in seconds, 0 for none
+PMSEC   EQU     XVARS+0x32          ; Last Timer0 second counted
+PMIDLE  EQU     XVARS+0x33          ; Timer0 second of the last bus command
+PMON    EQU     XVARS+0x34          ; Seconds with the 71B on (2 bytes)
+PMOFF   EQU     XVARS+0x36          ; Seconds awake with the 71B off (2 bytes)
+PMSLP   EQU     XVARS+0x38          ; Seconds napping or asleep (2 bytes)
+PMWAKE  EQU     XVARS+0x3a          ; IC from wake to INITDEV (2 bytes)
+PMNAPW  EQU     XVARS+0x2f          ; IC from CDn to ISVHI after a nap
+ENRDY   EQU     XVARS+0x3c          ; IC from INITDEV to ready (2 bytes)
+ENLATE  EQU     XVARS+0x3e          ; CDn fell before INITDEV was ready
+TRIDX   EQU     XVARS+0x3f          ; Next bus trace record
 
 DATABUF EQU     0x0100              ; Use SRAM page 1 for serial buffer
 SECTBUF EQU     0x0200              ; Use SRAM page 2 for sector buffer
+DECTBL  EQU     0x0300              ; SRAM page 3 for address decode table
+MIOFILE EQU     0x0400              ; SRAM page 4 for MMIO register file
+LMRING  EQU     0x0500              ; SRAM page 5 for live monitor output
+RXRING  EQU     0x0600              ; SRAM page 6 for serial bridge RX ring
+TXRING  EQU     0x0700              ; SRAM page 7 for serial bridge TX ring
+RAMBUF  EQU     0x0900              ; SRAM pages 9..C for the RAM device
+TRRING  EQU     0x0D00              ; SRAM page D for the bus trace
+SLKBUF  EQU     0x0800              ; SRAM page 8 for slack telemetry
+SLMIN   EQU     SLKBUF+0x08         ; Fewest IC since the edge, per site
+SLMAX   EQU     SLKBUF+0x10         ; Most IC since the edge, per site
+SLHIST  EQU     SLKBUF+0x20         ; Eight 2 IC buckets per site
+HEATBL  EQU     0x0E00              ; SRAM page E for the heat map
+SCREF   EQU     0x0E80              ; Committed CRC of blocks 0..7
+ROMNUM  EQU     MIOFILE             ; ROM Configuration nibble @ 2C000h
 
 ;//<editor-fold defaultstate="open" desc="No External Bootloader">
 #ifndef  XTRNBOOT
@@ -430,7 +1149,11 @@ RESVEC:
 ;PSECT isvhiVec,class=CODE,abs
 	org	0x08
 IV1:
+#if defined(FASTISR) && !defined(RAMDEV)
+        CMDVEC                      ; Exactly fills the vector up to 0x18
+#else
         goto    ISVHI
+#endif
     
 ;PSECT isvloVec,class=CODE,abs
 	org	0x18
@@ -449,21 +1172,24 @@ IV2:
 
 ;*******************************************************************************
 ; Configuration Constants
-; Each of the first seven entries in this table describe a soft or hard ROM.
+; Each of the first NROMS entries in this table describe a soft or hard ROM.
 ; Each entry consists of
 ;  Five nibble ID, Flag byte, Addr byte, Program Flash Memory Bank (ROMBANK)
 ;
 ; Soft ROMs are described in the first table entries, and they end when the
 ; Flag byte is non-zero.
 ; Each ID nibble is stored in a byte, starting with the first nibble.
-; PFM Bank is between 1 and 7.
+; PFM Bank is between 1 and 7, or 0 for the upper half of block 0. For an 8K
+; ROM (ID nibble 1 = 0Bh) bit 3 of the Bank selects the lower half.
 ;
-; Hard ROMs, if any, follow the last soft ROM entry. They use the Flag and Addr
+; Hard ROMs, if any, follow the last soft ROM entry. They use the Flag and Bank
 ; bytes.
 ;  The Flag byte indicates whether the entry is inactive (0) or active (ff).
-;  The Addr byte is used to address the lookup table that defines where the
-;  ROM appears in the Saturn address space. The values can be 0x1c & 0x1d for
-;  base address E0000h or 0x00 & 0x01 for base address 00000h.
+;  The two chips of a hard ROM appear at E0000h and E8000h in the Saturn
+;  address space, mapped from the PFM blocks in their Bank bytes.
+;
+; Several entries may name the same PFM block, so a 16K chip shared by two ROM
+; images is kept in flash once. See utils/romdedup.py.
 ; 
 ; Found out that the number of DB bytes per ROM config string MUST BE EVEN!
 ; An odd length ends up padding the extra byte with zero.
@@ -481,6 +1207,20 @@ ROM1:
 	DB 't', ' ', '2', '0', '2', '1', ',', ' '
 	DB 'M', 'a', 'r', 'k', ' ', 'A', '.', ' '
 	DB 'F', 'l', 'e', 'm', 'i', 'n', 'g'
+#ifdef   SERMON
+; Monitor string in the rest of the sector, which COMMIT never erases. See
+; STRING DATA in monitor.inc.
+STR80:  db    'X', 'E', 'C', 'U', 'T', 'E', ' ', '-', ' ', 'T'
+        db    'r', 'a', 'n', 's', 'f', 'e', 'r', ' ', 'P', 'r'
+        db    'o', 'c', 'e', 's', 's', 'o', 'r', ' ', 'C', 'o'
+        db    'n', 't', 'r', 'o', 'l', 13
+        db    'W', 'A', 'R', 'N', 'I', 'N', 'G', '!', ' ', 'M'
+        db    'a', 'k', 'e', ' ', 's', 'u', 'r', 'e', ' ', 'v'
+        db    'a', 'l', 'i', 'd', ' ', 'P', 'I', 'C', ' ', 'c'
+        db    'o', 'd', 'e', ' ', 'i', 's', ' ', 'i', 'n', ' '
+        db    'b', 'l', 'o', 'c', 'k', ' ', '0', '!', '!', 13
+        db    '(', 'Y', '/', 'N', ')', ' ',0
+#endif
 ; ROMs enumerated according to size
 ;ROM1    DB  0x0a, 0x00, 0x01, 0x00, 0x08, 0x00, 0x20, 1 ; 16K forth
 ;        DB  0x09, 0x01, 0x01, 0x00, 0x08, 0x00, 0x40, 2 ; 32K math2b
@@ -525,9 +1265,12 @@ ROM1:
 ;*******************************************************************************
 ; High Priority Interrupt Service Routine
 ; This ISR services a single interrupt source, the CDn signal that interrupts
-; on its falling edge. The ISR replaces the top of stack return address with
-; the address of the Command Dispatch task. That task reads the command nibble
-; and dispatches control to the appropriate code routine.
+; on its falling edge. The ISR empties the return stack and jumps to the
+; Command Dispatch task. That task reads the command nibble and dispatches
+; control to the appropriate code routine. The interrupted task is never
+; resumed, so any return address it left, such as that of an Idle task
+; service reached by a call, is dropped as well. Without that the stack
+; would fill up after a few dozen commands and STVREN would reset the PIC.
 ; 
 ; Note: Two instruction cycles can be saved by placing the service routine
 ;   directly at the interrupt service vector, eliminating the two IC goto
@@ -536,7 +1279,22 @@ ROM1:
 ; Latency
 ;   3/4 (response) + 2 (ISR goto) + 8 instruction cycles (13~14 IC)
 ;   There is a delay of ~125 ns between CDn fall and STRn fall, or 2 IC
+;   One more IC with RAMDEV, where NVMREG is pointed back to Program Flash
+;   Memory in case the command cut short a RAM device write back.
 ; 
+; FASTISR
+;   The CMDVEC macro empties the return stack as ISVHI does, but reads the
+;   command itself and jumps to DISPATCH.
+;   There is no return, so the fast register stack is never used. Without
+;   XTRNBOOT (and without RAMDEV, which needs one more word) CMDVEC
+;   sits on the hardware vector at 0x08 and the ISR goto disappears as well.
+;   Command read at 3/4 + 5 IC (no bootloader) or 3/4 + 7 IC (bootloader),
+;   against 3/4 + 2 + 8 + 3 IC through CMDREAD. DISPATCH is reached 4 IC
+;   (bootloader) or 6 IC (no bootloader) sooner.
+;   The command is then sampled 6~9 IC after STRn falls instead of close to
+;   its rise. Only use FASTISR on 71Bs where the monitor STATUS command reports
+;   the FAST timing profile.
+;
 ;*******************************************************************************
 ;        ORG     0x1100
 ;        ORG     0x900
@@ -544,21 +1302,44 @@ ROM1:
         ORG     0x900
 	global	ISVHI
 ISVHI:
-        ; How about POP, BRA CMDCYCLE ?
-        movlw   high(CMDREAD)       ;Vector control to command processing
-        movwf   TOSH,c
-        movlw   low(CMDREAD)
-        movwf   TOSL,c
+#ifdef  RAMDEV
+        bsf     NVMREG1             ; RAMSAVE may have selected data EEPROM
+#endif
+#ifdef  FASTISR
+        CMDVEC                      ; Read command and go to DISPATCH
+#else
+        clrf    STKPTR,c            ; Drop the interrupted task's returns
         banksel PIR0
         bcf     INT0IF              ; Clear interrupt flag
-        retfie
+        bra     $+2                 ; Command sample point as with retfie
+#ifdef  POWERMGT
+        bcf     T1GCON,3,c          ; T1GGO, end of a nap wake count
+#else
+        nop
+#endif
+        goto    CMDREAD             ; CMDREAD enables interrupts again
+#endif
+
+#ifdef   SERMON
+; Monitor strings in the space left up to the Low Priority ISR
+STR30:  db    'C', 'O', 'M', 'M', 'I', 'T', '?', ' ', '(', 'Y'
+        db    '/', 'n', ')', ' ', 0
+STR31:  db    13, 'C', 'o', 'n', 'f', 'i', 'r', 'm', 'e', 'd', 13, 13, 0
+STR32:  db    13, 'C', 'a', 'n', 'c', 'e', 'l', 'l', 'e', 'd', 13, 13, 0
+STR33:  db    13, 'C', 'o', 'u', 'l', 'd', 'n', "'", 't', ' '
+        db    'e', 'r', 'a', 's', 'e', ' ', 's', 'e', 'c', 't'
+        db    'o', 'r', 13, 13, 0
+STR41:  db    'E', 'r', 'r', 'o', 'r', ' ', 'w', 'r', 'i', 't'
+        db    'i', 'n', 'g', ' ', 'w', 'o', 'r', 'd', 13, 0
+#endif
 
 
 ;*******************************************************************************
 ; Low Priority Interrupt Service Routine
 ; This ISR can service more than one interrupt source. That source can be
 ; - Rising edge of the Daisy-In signal. Transfer control to the Initialize
-;   Device task where interrupts are disabled and devices are configured
+;   Device task where interrupts are disabled and devices are configured.
+;   Like ISVHI it drops whatever the interrupted task left on the stack.
 ; - Other. Serial port receive buffer full or transmit buffer empty could be
 ;   handled here.
 ; 
@@ -567,7 +1348,7 @@ ISVHI:
 ;   instruction delay.
 ; 
 ; Latency
-;   3/4 (response) + 2 (ISR goto) + 8 instruction cycles (13~14 IC)
+;   3/4 (response) + 2 (ISR goto) + 10 instruction cycles (15~16 IC)
 ; 
 ;*******************************************************************************
 ;        ORG     0x1180
@@ -575,6 +1356,11 @@ ISVHI:
 	global	ISVLO
 ISVLO:
         ; Din goes high
+#ifdef  RAMDEV
+        bsf     NVMREG1             ; RAMSAVE may have selected data EEPROM
+#endif
+        movlw   0x01                ; Keep only the interrupt return address
+        movwf   STKPTR,c
         movlw   high(INITDEV)       ;Vector control to device initialization
         movwf   TOSH,c
         movlw   low(INITDEV)
@@ -583,6 +1369,18 @@ ISVLO:
         bcf     INT1IF              ; Clear interrupt flag
         retfie
 
+#ifdef   SERMON
+; Monitor strings in the space left up to the application code
+STR90:  db    'P', 'L', 'U', 'G', ' ', 'R', 'O', 'M', 's', ' '
+        db    'I', 'N', '?', ' ', '(', 'Y', '/', 'N', ')', ' ', 0
+STR91:  db    13, 'M', 'a', 'i', 'n', ' ', 'R', 'O', 'M', 's'
+        db    ' ', 'p', 'l', 'u', 'g', 'g', 'e', 'd', ' ', 'i', 'n', 13, 0
+STR92:  db    13, 'A', 'l', 'l', ' ', 'R', 'O', 'M', 's', ' '
+        db    'u', 'n', 'p', 'l', 'u', 'g', 'g', 'e', 'd', 13, 0
+STR53:  db    'E', 'r', 'r', 'o', 'r', ' ', 'e', 'r', 'a', 's'
+        db    'i', 'n', 'g', ' ', 's', 'e', 'c', 't', 'o', 'r', 13, 0
+#endif
+
 
 ;*******************************************************************************
 ; MAIN PROGRAM AREA
@@ -594,6 +1392,12 @@ ISVLO:
 START:
         ; Hardware initialization here from power-on reset
         call    INITMOD
+#ifdef  HALTWAKE
+        btfsc   SIGPORT,Din,c       ; Only HALT a 71B that is turned off
+        bra     $+6
+        bsf     SIGLAT,Halt71,c     ; HALT until INITDEV has the tables ready
+        bcf     SIGTRIS,Halt71,c
+#endif
         call    HARDRST
         DATAIN                      ; Should always default to DATAIN
         ;; Debug
@@ -634,24 +1438,49 @@ INITDEV:
         bcf     INT0IF              ; Clear interrupt flag
         bcf     INT1IF              ; Clear interrupt flag
         banksel CMD
-;*******************************************************************************
-; EXPERIMENTAL!
-; This code is used to assert & deassert the Halt signal to the Saturn CPU to
-; allow the PIC enough time to recover from sleep and continue processing.
-; Its purpose is to support a takeover ROM.
-;*******************************************************************************
-;        bcf     SIGLAT,Halt71,0     ; Clear HALT signal
-;        bsf     SIGTRIS,Halt71,0    ; Disable HALT signal output driver
-;*******************************************************************************
+#ifdef  POWERMGT
+        btfss   PMFLG,pmWAKE,b      ; Skip after a wake from Sleep
+        bra     $+12
+        movff   TMR1L,PMWAKE        ; Instruction cycles since the wake
+        movff   TMR1H,PMWAKE+1
+        bcf     PMFLG,pmWAKE,b
+        clrf    T1GCON,c            ; A nap may have left the gate on
+#endif
+        clrf    TMR1H,c             ; Time the enumeration set up
+        clrf    TMR1L,c
         FLAGLO
+#ifdef  PROFILE
+        movf    PFREQ,w,b           ; Finish a ROM profile copy under way
+        bz      $+8
+        call    PFSVC
+        bra     $-8
+#endif
         call    INITVAR
         call    INITTAB
+#ifdef  HALTWAKE
+        ; Hold the Saturn until the clock and the tables are ready
+        banksel OSCSTAT
+        btfss   OSCSTAT,OSCSTAT_HFOR_POSN,b     ; HFINTOSC ready?
+        bra     $-2
+        banksel CMD
+        bcf     SIGLAT,Halt71,c     ; Clear HALT signal
+        bsf     SIGTRIS,Halt71,c    ; Disable HALT signal output driver
+#endif
+        movff   TMR1L,ENRDY         ; Instruction cycles to get ready
+        movff   TMR1H,ENRDY+1
+        movff   PIR0,WREG
+        btfsc   WREG,PIR0_INT0IF_POSN,c     ; Skip unless CDn fell meanwhile
+        incf    ENLATE,f,b          ; A command went by unanswered
         movlw   NROMS               ; Don't scan beyond end of table
         movwf   CNTR,c              ; Limit number of table entries scanned
         lfsr    0,ROMDAT            ; Point to first ROM entry
+#ifdef  RAMDEV
+        lfsr    0,RAMDAT            ; RAM device goes ahead of the ROMs
+#endif
 
+        movff   ROMNUM,TEMP         ; ROM configuration from MMIO register 0
         movlw   0x00
-        cpfsgt  ROMNUM,c            ; Skip if ROMNUM > 0
+        cpfsgt  TEMP,c              ; Skip if ROMNUM > 0
         bra     INIEXIT             ; A zero in ROMNUM unplugs all ROMs
                                     ; Should be EXITINI
         btfss   SIGPORT,Din,c       ; Only enumerate when Daisy-In is high
@@ -660,6 +1489,8 @@ ENUMROM:
         NEGEDGE CDn
         NEGEDGE STRn
         ;NEGEDGE STRn               ; Command appears much later in older 71B
+        BUSRD                       ; Early sample for the timing profile
+        movwf   TEMP,c
         POSEDGE STRn                ; Must sample as close as can to this edge
         ;FLAGHI
         BUSRD
@@ -672,9 +1503,11 @@ ENUMROM:
         ; Execute ID command
         movlw   teID1
         BUSWR   PLUSW0
+        SLPROBE slID
         ;FASTOUT                    ; 4~7 + 2 instruction cycles
-        NEGEDGE STRn                ; 2~4 + 2 instruction cycles
+        NEGEDGE STRn                ; 2~4 + 3 instruction cycles
         DATAOUT
+        clrf    TMR1L,c             ; Start of the STRn period measurement
         FLAGHI
         POSEDGE STRn                ; 2~4 + 4 instruction cycles
         DATAIN
@@ -706,11 +1539,16 @@ ENUMROM:
         movlw   teID5
         BUSWR   PLUSW0
         ;FASTOUT                    ; 4~7 + 2 instruction cycles
-        NEGEDGE STRn                ; 2~4 + 2 instruction cycles
+        NEGEDGE STRn                ; 2~4 + 4 instruction cycles
         DATAOUT
+        movff   TMR1L,STRPER        ; Four STRn periods since ID nibble 1
         POSEDGE STRn                ; 2~4 + 2 instruction cycles
         DATAIN
         FLAGLO
+        movf    CMD,w,c
+        cpfseq  TEMP,c              ; Skip if command was valid early
+        bsf     TIMPRF,tpLATE,b     ; Data came late, old Saturn timing
+        incf    TIMCNT,f,b
         ; Exit on last CONFIG command, not last ID
 ;        movlw   teFLAG              ; Flag byte in table entry
 ;        btfsc   PLUSW0,teLAST,c     ; Is this the end-of-module entry?
@@ -727,40 +1565,54 @@ INIT2:
 
 	LOADREG ADDR,APTR,ARANGE
 
-        rlcf    ADDR+1,w,c          ; Addr bit 15 to carry
-        rlcf    ADDR+2,w,c          ; Addr bits 19 downto 15
+        movf    CMD,w,c
+        cpfseq  TEMP,c              ; Skip if command was valid early
+        bsf     TIMPRF,tpLATE,b     ; Data came late, old Saturn timing
+        incf    TIMCNT,f,b
+        swapf   ADDR+1,w,c          ; Addr bits 15 downto 12
+        andlw   0x0f
         movwf   ARANGE,c
+        swapf   ADDR+2,w,c          ; Addr bits 19 downto 16
+        iorwf   ARANGE,f,c
         FLAGLO
+        TLINC   TLCFG               ; 2~3 instruction cycles
 DOMAP:
-        ; Mapping table entry precomputed during reset
-        movlw   teADDR              ; Entry index of mapping address
-        movff   PLUSW0,MAPVAL       ; Block number to temporary
+#ifdef  RAMDEV
+        movlw   teFLAG
+        btfsc   PLUSW0,teRAM,c      ; Skip unless the RAM device entry
+        bra     RAMMAP
+#endif
+        ; Mapping byte precomputed during reset
         movlw   teID1               ; First ID nibble is ROM size
         movff   PLUSW0,ROMSIZ       ; Table entry ID first nibble
-        movf    ARANGE,w,c          ; Table address is upper 5 bits of address
-        movff   MAPVAL,PLUSW2       ; Entry is Block number!
+        movf    ARANGE,w,c          ; Decode entry of the first 4K page
+        call    DECPTR
+        movlw   te8K                ; 8K ROM size
+        cpfslt  ROMSIZ,c            ; Skip if 16K or larger
+        bra     DOMAP8
+        movlw   teADDR              ; Entry index of mapping byte
+        movf    PLUSW0,w,c
+        call    MAPCHIP             ; First 16K PFM block
         movlw   te16K               ; 16K ROM size
         cpfslt  ROMSIZ,c            ; Skip if ROM larger than 16K
         bra     INICHK
         movlw   0x20                ; Increment top 3 mapping bits
-        addwf   MAPVAL,f,c          ; Point to next block
-        movf    ARANGE,w,c          ; Table address is upper 5 bits of address
-        incf    WREG,f,c            ; ROM is 32K or 64K
-        movff   MAPVAL,PLUSW2         ; Entry is Block number!
+        addwf   MAPVAL,w,c          ; Point to next block
+        call    MAPCHIP
         movlw   te32K               ; 32K ROM size
         cpfslt  ROMSIZ,c            ; Skip if ROM larger than 32K
         bra     INICHK
-        movf    ARANGE,w,c          ; ???Table address is upper 5 bits of address
-        movlw   0x20                ; Increment top 3 mapping bits
-        addwf   MAPVAL,f,c          ; Point to next block
-        movf    ARANGE,w,c          ; Table address is upper 5 bits of address
-        addlw   0x02                ; ROM is 64K
-        movff   MAPVAL,PLUSW2         ; Entry is Block number!
-        movlw   0x20                ; Increment top 3 mapping bits
-        addwf   MAPVAL,f,c          ; Point to next block
-        movf    ARANGE,w,c          ; Table address is upper 5 bits of address
-        addlw   0x03                ; ROM is 64K
-        movff   MAPVAL,PLUSW2         ; Entry is Block number!
+        movlw   0x20                ; ROM is 64K
+        addwf   MAPVAL,w,c
+        call    MAPCHIP
+        movlw   0x20
+        addwf   MAPVAL,w,c
+        call    MAPCHIP
+        bra     INICHK
+DOMAP8:
+        movlw   teADDR              ; Entry index of mapping byte
+        movf    PLUSW0,w,c
+        call    MAP8K               ; 8K in one half of a PFM block
 INICHK:
         ; Check boundary condition: Last entry to enumerate
         movlw   teFLAG              ; Flag byte in table entry
@@ -786,7 +1638,8 @@ INICHK:
         bra     ENUMCHK
 INIHDN:
         ; Check boundary condition: Hidden ROM is disabled
-        btfsc   ROMNUM,cfHIDDEN,c   ; Should hidden ROM be configured?
+        movff   ROMNUM,WREG
+        btfsc   WREG,cfHIDDEN,c     ; Should hidden ROM be configured?
         bra     ENUMCHK             ; Hidden ROM enabled, continue
         movlw   teFLAG
         btfsc   PLUSW0,teLAST,c     ; Skip if not Last Flag
@@ -798,27 +1651,41 @@ ENUMCHK:
         bra     ENUMROM             ;  messed up with missing Last flag
 INIEXIT:
         ; See if there's a hard ROM in last two table entries
-        lfsr    1,ROMDAT+((NROMS-2)*ROMLEN)
+        lfsr    0,ROMDAT+((NROMS-2)*ROMLEN)
         movlw   teFLAG              ; See if hard ROM flag set
-        btfss   PLUSW1,teHARD,c     ; Skip if flag set
+        btfss   PLUSW0,teHARD,c     ; Skip if flag set
         bra     EXITINI             ; Not set, finish up
-        movlw   0xc0                ; Mapping bits for bank 6
-        movwf   TEMP,c
-        movlw   teADDR
-        movf    PLUSW1,w,c          ; Mapping address to WREG
-        movff   TEMP,PLUSW2
+        movlw   0xe0                ; First chip at E0000h
+        call    HRDCHIP
         movlw   ROMLEN              ; Bump pointer to next ROM entry
-        addwf   FSR1L,f,c
-        movlw   0xe0                ; Mapping bits for bank 7
-        movwf   TEMP,c
-        movlw   teADDR
-        movf    PLUSW1,w,c          ; Mapping address to WREG
-        movff   TEMP,PLUSW2
+        addwf   FSR0L,f,c
+        movlw   0xe8                ; Second chip at E8000h
+        call    HRDCHIP
 EXITINI:
+        ; Flag the 4K page holding the MMIO window
+        banksel ROMDAT
+        movf    MMIO+2,w,b          ; LOADREG compares nibble 2 in page 0
+        movwf   MION2,c
+        swapf   MMIO+4,w,b          ; MMIO address bits 19..12
+        iorwf   MMIO+3,w,b
+        banksel CMD
+        call    DECPTR
+        bsf     INDF1,dtMIO,c
+        ; Use the fast LOADREG profile only if enough commands were sampled
+        ; early and none of them came late
+        movlw   TIMMIN
+        cpfslt  TIMCNT,b            ; Skip if too few samples
+        btfsc   TIMPRF,tpLATE,b     ; Skip if data was always valid early
+        bra     $+4
+        bsf     TIMPRF,tpFAST,b
+        call    MIOSTAT
         banksel PIR0
         bcf     INT0IF              ; Clear CDn flag
         bcf     INT1IF              ; Clear Din flag
         banksel CMD
+#if defined(BUSTRACE) || defined(TELEM)
+        setf    CMD,c               ; No bus command to trace or count yet
+#endif
         setf    RDY,c               ; Device has been configured
         bsf     GIEH                ; High Priority Interrupt Enable
         bsf     GIEL                ; Low Priority Interrupt Enable
@@ -843,26 +1710,103 @@ NODOFF:
         ;FLAGLO
         ; Set up power saving configuration
         banksel CMD
+#ifdef  SCRUB
+        bcf     SCST,scRUN,b        ; Scan the block again after the wake
+#endif
         ;FLAGHI
         clrf    PORTB,c             ; Set outputs low to save power
-;*******************************************************************************
-; EXPERIMENTAL!
-; This code is used to assert & deassert the Halt signal to the Saturn CPU to
-; allow the PIC enough time to recover from sleep and continue processing.
-; Its purpose is to support a takeover ROM.
-;*******************************************************************************
-;        bsf     SIGLAT,Halt71,0     ; Set HALT signal high
-;        bcf     SIGTRIS,Halt71,0    ; Enable HALT signal output driver
-;*******************************************************************************
+#ifdef  HALTWAKE
+        btfsc   SIGPORT,Din,c       ; Only HALT a 71B that is turned off
+        bra     $+6
+        bsf     SIGLAT,Halt71,c     ; Set HALT signal high
+        bcf     SIGTRIS,Halt71,c    ; Enable HALT signal output driver
+#endif
         bcf     GIEH                ; Interrupt Disable, don't invoke ISR
+#ifdef  POWERMGT
+        bsf     PMFLG,pmSLEEP,b     ; Count the time asleep
+        bsf     PMFLG,pmWAKE,b      ; and how long waking up takes
+        banksel PIR0
+        bcf     TMR0IF
+        banksel PIE0
+        bsf     TMR0IE              ; Count Timer0 periods while asleep
+#endif
         banksel CPUDOZE
         bcf     IDLEN               ; Some suggest this must be before sleep
+NODSLP:
         sleep
+#ifdef  POWERMGT
+        banksel PIR0
+        btfss   TMR0IF              ; Skip if Timer0 ended the sleep
+        bra     NODWAK
+        bcf     TMR0IF
+        banksel CMD
+        incf    PMSLP+1,f,b         ; Another 256 seconds asleep
+        bra     NODSLP
+NODWAK:
+        clrf    TMR1H,c             ; Time the wake up
+        clrf    TMR1L,c
+#endif
+#ifdef  TELEM
+        banksel CMD
+        TLINC   TLWAKE
+#endif
         bra     INITDEV             ; Wait for initiaization on CDn or Din
+#ifdef  POWERMGT
+;*******************************************************************************
+; NAP
+; Entered on SHUTDOWN and on the idle timeout. Go to Sleep if the 71B is off,
+; otherwise stop the CPU in Idle mode until CDn, Din or Timer0 ends the nap.
+; CDn goes through the ISR as usual and leaves GIEL off, TMR0IE set and the
+; Timer1 gate on for IDLE to undo.
+;*******************************************************************************
+PMNAP:
+        banksel CMD
+        btfss   SIGPORT,Din,c       ; Skip while the 71B is on
+        bra     NODOFF
+        bsf     PMFLG,pmSLEEP,b     ; Count the time napping
+        bcf     GIEL                ; Din and Timer0 wake without the ISR
+        banksel PIR0
+        bcf     TMR0IF
+        banksel PIE0
+        bsf     TMR0IE
+        banksel CPUDOZE
+        bsf     IDLEN               ; Idle mode, the clock keeps running
+#ifndef FASTISR
+        clrf    TMR1H,c             ; Count from CDn low to ISVHI
+        clrf    TMR1L,c
+        movlw   0x90                ; Gate on, active low, single pulse
+        movwf   T1GCON,c
+        bsf     T1GCON,3,c          ; T1GGO, wait for CDn
+#endif
+        sleep
+#ifndef FASTISR
+        clrf    T1GCON,c            ; Din or Timer0, no count
+#endif
+        banksel PIR0
+        btfsc   INT1IF              ; Skip unless Din rose
+        bra     IDLE                ; IDLE enables GIEL for the Din ISR
+        banksel CMD
+        incf    PMSLP+1,f,b         ; Timer0 period, another 256 seconds
+        bra     PMNAP               ; Nap again or sleep
+#endif
 IDLE:
-        ;banksel CPUDOZE
-        ;movlw   0x67                ; Doze, Recover on Interrupt, 1:256
-        ;movwf   CPUDOZE,1
+#ifdef  BUSTRACE
+        call    TRIDLE              ; Record the command that ended here
+#endif
+#ifdef  TELEM
+        call    TLIDLE              ; Count the command that ended here
+#endif
+#ifdef  POWERMGT
+        banksel PIE0
+        bcf     TMR0IE              ; Timer0 only ends a nap
+        bsf     GIEL                ; A nap ended by CDn left it off
+        banksel CMD
+        movff   TMR0L,PMIDLE        ; Time of the last bus command
+        btfss   T1GCON,7,c          ; Skip if T1GE, a nap ended by CDn
+        bra     $+8
+        movff   TMR1L,PMNAPW        ; Instruction cycles to ISVHI
+        clrf    T1GCON,c            ; Timer1 free running again
+#endif
         banksel CMD
         clrf    APTR,c              ; Timeout counter for inactivity
         clrf    APTR+1,c
@@ -884,20 +1828,478 @@ NOBREAK:
 #endif   ; end of #ifdef XTRNBOOT
 
 #ifdef   SERMON
+#ifdef  BRIDGE
+        call    BRGSVC              ; Z clear while the bridge owns the port
+        bnz     NOMON
+#endif
+#ifdef  LIVEMON
+        btfss   SIGPORT,Din,c       ; Skip while the 71B is on
+        bra     $+8
+        call    LIVSVC              ; One slice of the live monitor
+        bra     NOMON
+#endif
         ; Check for serial port activity
         banksel PIR3
         btfsc   RC1IF               ; Receive Interrupt bit set?
         goto    MONITOR             ; Handle incoming serial data
         ;banksel CMD
+#if defined(BRIDGE) || defined(LIVEMON)
+NOMON:
+#endif
 #endif
 
         banksel CMD
+#ifdef  RAMDEV
+        btfsc   RAMFLG,rfSAVE,b     ; Skip unless saving the RAM device
+        call    RAMSAVE
+#endif
+#ifdef  COPROC
+        movff   MIOFILE+mrOP,WREG   ; Coprocessor request pending?
+        tstfsz  WREG,c
+        call    CPSTEP
+#endif
+#ifdef  SLACK
+        call    SLSVC               ; Count the new slack samples
+#endif
+#ifdef  TELEM
+        call    TLSHOW              ; Copy a counter to the MMIO registers
+#endif
+#ifdef  SCRUB
+        call    SCSVC               ; Check the next flash block
+#endif
+#ifdef  PROFILE
+        call    PFSVC               ; Load the ROM profile asked for
+#endif
+#ifdef  POWERMGT
+        movf    PMSEC,w,b
+        cpfseq  TMR0L,c             ; Skip when every second is counted
+        bra     PMTICK
+        bcf     PMFLG,pmSLEEP,b     ; The nap or sleep is counted
+        movf    PMTMO,w,b
+        bz      IDLELP              ; A timeout of 0 never sleeps
+        movf    PMIDLE,w,b
+        subwf   TMR0L,w,c           ; Seconds since the last bus command
+        cpfsgt  PMTMO,b             ; Skip while short of the timeout
+        bra     PMNAP
+        bra     IDLELP
+PMTICK:
+        incf    PMSEC,f,b           ; Count it first, a CDn loses the second
+        movlw   low(PMON)
+        btfss   SIGPORT,Din,c       ; Skip while the 71B is on
+        movlw   low(PMOFF)
+        btfsc   PMFLG,pmSLEEP,b     ; Skip unless napping or asleep
+        movlw   low(PMSLP)
+        movwf   FSR1L,c
+        clrf    FSR1H,c
+        infsnz  POSTINC1,f,c
+        incf    INDF1,f,c
+        bra     IDLELP
+#else
         INCREG  APTR                ; Incrementing every 1/(64MHz/256)
         btfsc   CARRY               ; Skip if no carry
         incf    CNTR,f,c
         btfsc   CNTR,4,c            ; About 2.5 minutes
         bra     NODOFF
+#ifdef  HALTWAKE
+        btfss   CNTR,0,c            ; About 10 seconds
         bra     IDLELP
+        btfss   SIGPORT,Din,c       ; Skip while the 71B is on
+        bra     NODOFF
+#endif
+        bra     IDLELP
+#endif
+
+#ifdef  BUSTRACE
+;*******************************************************************************
+; Record the bus command that ended in the Idle task, once. CMD is set to 0FFh
+; when it is done, and the next dispatch replaces it. Uses FSR0.
+;*******************************************************************************
+TRIDLE:
+        btfsc   CMD,7,c             ; Skip unless recorded already
+        return
+        btfsc   CMD,0,c             ; Skip unless the command uses DP
+        bra     TRIDP
+        TRACE   PCREG
+        setf    CMD,c
+        return
+TRIDP:
+        TRACE   DPREG
+        setf    CMD,c
+        return
+#endif
+
+#ifdef  SLACK
+;*******************************************************************************
+; Fold the new slack samples into the smallest and largest value and the
+; histogram of each site. See Slack Telemetry above. Uses FSR1 and TEMP.
+;*******************************************************************************
+SLSVC:
+        lfsr    1,SLKBUF            ; Latest sample of each site
+SLSLP:
+        movf    INDF1,w,c
+        xorlw   0xff
+        bz      SLSNXT              ; Nothing new at this site
+        setf    INDF1,c             ; Take the sample first
+        xorlw   0xff
+        movwf   TEMP,c
+        movlw   SLMIN-SLKBUF
+        movf    PLUSW1,w,c          ; Smallest so far
+        cpfslt  TEMP,c              ; Skip if the sample is smaller
+        bra     $+8
+        movlw   SLMIN-SLKBUF
+        movff   TEMP,PLUSW1
+        movlw   SLMAX-SLKBUF
+        movf    PLUSW1,w,c          ; Largest so far
+        cpfsgt  TEMP,c              ; Skip if the sample is larger
+        bra     $+8
+        movlw   SLMAX-SLKBUF
+        movff   TEMP,PLUSW1
+        movlw   0x0f                ; Last bucket holds 14 IC and more
+        cpfslt  TEMP,c              ; Skip if below
+        movwf   TEMP,c
+        rrncf   TEMP,f,c
+        bcf     TEMP,7,c            ; Bucket 0..7
+        movf    FSR1L,w,c           ; Site
+        mullw   7                   ; Offset of its histogram less the site
+        movf    PRODL,w,c
+        addlw   SLHIST-SLKBUF
+        addwf   TEMP,w,c
+        incfsz  PLUSW1,f,c          ; Count, stop at 255
+        bra     SLSNXT
+        decf    PLUSW1,f,c
+SLSNXT:
+        incf    FSR1L,f,c
+        movlw   SLSITES
+        cpfseq  FSR1L,c             ; Skip after the last site
+        bra     SLSLP
+        return
+
+;*******************************************************************************
+; Start the slack telemetry over. Uses FSR1.
+;*******************************************************************************
+SLINIT:
+        lfsr    1,SLKBUF
+        setf    POSTINC1,c          ; No samples, smallest values 0FFh
+        btfss   FSR1L,4,c           ; Skip at the largest values
+        bra     $-4
+        movlw   low(SLHIST+8*SLSITES)
+        clrf    POSTINC1,c          ; Largest values and histograms
+        cpfseq  FSR1L,c             ; Skip at the end of the histograms
+        bra     $-4
+        return
+#endif
+
+#ifdef  HEATMAP
+;*******************************************************************************
+; Clear the heat map counters. Uses FSR1.
+;*******************************************************************************
+HMINIT:
+        lfsr    1,HEATBL
+        movlw   0x80                ; 64 counters of 2 bytes
+        clrf    POSTINC1,c
+        cpfseq  FSR1L,c             ; Skip at the end of the counters
+        bra     $-4
+        return
+#endif
+
+#ifdef  TELEM
+;*******************************************************************************
+; Count the bus command that ended in the Idle task, once, and a LOAD PC or
+; LOAD DP that got here as a miss. PC/DP READ and LOAD PC/DP were counted
+; when they started. CMD is set to 0FFh when it is done, and the next
+; dispatch replaces it. Uses FSR0.
+;*******************************************************************************
+TLIDLE:
+        btfsc   CMD,7,c             ; Skip unless counted already
+        return
+        movf    CMD,w,c
+        andlw   0x0a
+        xorlw   cmdPCREAD           ; Commands 2, 3, 6 and 7?
+        bz      TLIDL1
+        TLCMD
+TLIDL1:
+        movf    CMD,w,c
+        andlw   0x0e
+        xorlw   cmdLOADPC           ; LOAD PC or LOAD DP?
+        bnz     $+6
+        TLINC   TLMISS
+        setf    CMD,c
+        return
+
+;*******************************************************************************
+; Copy the telemetry counter TLIDX to its four MMIO registers, low nibble
+; first, and move on to the next one. The hits are worked out first. See
+; Telemetry Counters above. Uses FSR0 and FSR1.
+;*******************************************************************************
+TLSHOW:
+        movf    TLCNT+2*cmdLOADPC,w,b       ; LOADs less the misses
+        addwf   TLCNT+2*cmdLOADDP,w,b
+        movwf   TLHIT,b
+        movf    TLCNT+2*cmdLOADPC+1,w,b
+        addwfc  TLCNT+2*cmdLOADDP+1,w,b
+        movwf   TLHIT+1,b
+        movf    TLMISS,w,b
+        subwf   TLHIT,f,b
+        movf    TLMISS+1,w,b
+        subwfb  TLHIT+1,f,b
+        lfsr    0,TLCNT
+        movf    TLIDX,w,b           ; Byte offset of the counter
+        addwf   FSR0L,f,c
+        lfsr    1,MIOFILE+mrTEL
+        addwf   FSR1L,f,c
+        addwf   FSR1L,f,c           ; Four registers per counter
+        movf    INDF0,w,c
+        andlw   0x0f
+        movwf   POSTINC1,c
+        swapf   POSTINC0,w,c
+        andlw   0x0f
+        movwf   POSTINC1,c
+        movf    INDF0,w,c
+        andlw   0x0f
+        movwf   POSTINC1,c
+        swapf   INDF0,w,c
+        andlw   0x0f
+        movwf   INDF1,c
+        movf    TLIDX,w,b
+        addlw   0x02                ; Next counter
+        xorlw   2*TLNUM
+        bz      $+4                 ; Start over after the last one
+        xorlw   2*TLNUM
+        movwf   TLIDX,b             ; Commit
+        return
+#endif
+
+#ifdef  SCRUB
+;*******************************************************************************
+; Run one step of the flash scrub. See Flash Scrub above. Uses FSR1 and TEMP.
+;*******************************************************************************
+SCSVC:
+        btfsc   SCST,scOFF,b        ; Skip if CRCs were committed
+        return
+        btfsc   SCST,scRUN,b        ; Skip unless the scan was started
+        bra     SCWAIT
+        movf    SCST,w,b
+        rcall   SCGO
+        bsf     SCST,scRUN,b        ; Commit
+        return
+SCWAIT:
+        banksel SCANCON0
+        btfsc   SCANCON0,SCANCON0_SCANGO_POSN,b ; Skip when the scan is done
+        bra     SCEXIT
+        banksel CRCCON0
+        btfsc   CRCCON0,CRCCON0_BUSY_POSN,b     ; Skip when the CRC is done
+        bra     SCEXIT
+        banksel CMD
+        lfsr    1,SCREF             ; Committed CRC of the block
+        movf    SCST,w,b
+        andlw   0x07
+        addwf   WREG,w,c
+        addwf   FSR1L,f,c
+        movff   CRCACCL,WREG
+        xorwf   POSTINC1,w,c
+        movwf   TEMP,c
+        movff   CRCACCH,WREG
+        xorwf   INDF1,w,c
+        iorwf   TEMP,f,c            ; Zero if the CRC matches
+        movlw   0x01                ; Bit of the block in SCBAD
+        btfsc   SCST,0,b
+        movlw   0x02
+        btfsc   SCST,1,b
+        rlncf   WREG,w,c
+        btfsc   SCST,1,b
+        rlncf   WREG,w,c
+        btfsc   SCST,2,b
+        swapf   WREG,w,c
+        tstfsz  TEMP,c              ; Skip if the CRC matches
+        bra     SCFAIL
+        comf    WREG,w,c
+        andwf   SCBAD,f,b
+        bra     SCNEXT
+SCFAIL:
+        iorwf   SCBAD,f,b
+SCNEXT:
+        movf    SCBAD,w,b           ; Blocks 3..0 and 7..4
+        andlw   0x0f
+        movff   WREG,MIOFILE+mrSCRUB
+        swapf   SCBAD,w,b
+        andlw   0x0f
+        movff   WREG,MIOFILE+mrSCRUB+1
+        incf    SCST,w,b            ; Next block, not started
+        andlw   0x07
+        movwf   SCST,b              ; Commit
+        return
+SCEXIT:
+        banksel CMD
+        return
+
+;*******************************************************************************
+; Start the CRC-16 of PFM block WREG (0..7), fed by the scanner in Peek mode.
+; A scan under way is stopped first. Block 0 is scanned from 2000h. BSR = 0
+; on return. Uses TEMP.
+;*******************************************************************************
+SCGO:
+        andlw   0x07
+        movwf   TEMP,c
+        banksel SCANCON0
+        clrf    SCANCON0,b          ; Stop a scan under way
+        banksel CRCCON0
+        clrf    CRCCON0,b
+        setf    CRCCON1,b           ; 16-bit data and polynomial
+        movlw   0x10                ; CRC-16/CCITT, 1021h
+        movwf   CRCXORH,b
+        movlw   0x21
+        movwf   CRCXORL,b
+        setf    CRCACCH,b           ; Seed 0FFFFh
+        setf    CRCACCL,b
+        movlw   0xc0                ; EN and GO, data not augmented
+        movwf   CRCCON0,b
+        banksel SCANCON0
+        clrf    SCANLADRL,b         ; First and last byte of the block
+        setf    SCANHADRL,b
+        rrncf   TEMP,w,c            ; Block bits 1..0 to address bits 15..14
+        rrncf   WREG,w,c
+        andlw   0xc0
+        tstfsz  TEMP,c              ; Skip for block 0
+        bra     $+4
+        movlw   0x20                ; Upper half of block 0
+        movwf   SCANLADRH,b
+        iorlw   0x3f
+        movwf   SCANHADRH,b
+        clrf    SCANLADRU,b
+        btfsc   TEMP,2,c            ; Skip for blocks 0..3
+        incf    SCANLADRU,f,b
+        movf    SCANLADRU,w,b
+        movwf   SCANHADRU,b
+        movlw   0x82                ; EN, Peek mode
+        movwf   SCANCON0,b
+        bsf     SCANCON0,SCANCON0_SCANGO_POSN,b
+        banksel CMD
+        return
+
+;*******************************************************************************
+; Take the CRC of blocks 0..7 into SCREF for COMMIT. The scanner runs while
+; the CPU waits. Uses FSR1, CNTR and TEMP.
+;*******************************************************************************
+SCREFS:
+        lfsr    1,SCREF
+        clrf    CNTR,c
+SCRFLP:
+        movf    CNTR,w,c
+        rcall   SCGO
+        banksel SCANCON0
+        btfsc   SCANCON0,SCANCON0_SCANGO_POSN,b ; Skip when the scan is done
+        bra     $-2
+        banksel CRCCON0
+        btfsc   CRCCON0,CRCCON0_BUSY_POSN,b     ; Skip when the CRC is done
+        bra     $-2
+        movff   CRCACCL,POSTINC1
+        movff   CRCACCH,POSTINC1
+        banksel CMD
+        incf    CNTR,f,c
+        btfss   CNTR,3,c            ; Skip after block 7
+        bra     SCRFLP
+        return
+#endif
+
+#ifdef  PROFILE
+;*******************************************************************************
+; Take one step towards serving the ROM profile in MMIO register mrPROF. See
+; ROM Profiles above. Uses FSR1 and TEMP, and HABUILD for profile 0.
+;*******************************************************************************
+PFSVC:
+        movf    PFREQ,w,b
+        bnz     PFCOPY              ; Copy under way
+        movff   MIOFILE+mrPROF,TEMP
+        movf    TEMP,w,c
+        cpfseq  PFCUR,b             ; Skip if the profile is served already
+        bra     PFNEW
+        return
+PFNEW:
+        bz      PFASK               ; The flash table is always there
+        decf    TEMP,w,c
+        sublw   NPROF-1             ; Borrow unless profile 1..NPROF
+        bnc     PFBAD
+        movlw   ROMLEN*(NROMS+1)    ; Saved profiles are marked after MMIO
+        rcall   PFREAD
+        xorlw   BOOTREC
+        bnz     PFBAD
+PFASK:
+        clrf    PFIDX,b
+        movlw   0x80                ; Nonzero for profile 0 as well
+        iorwf   TEMP,w,c
+        movwf   PFREQ,b             ; Commit
+        return
+PFBAD:
+        movff   PFCUR,MIOFILE+mrPROF    ; Refused, show the profile served
+        return
+PFCOPY:
+        andlw   0x7f
+        movwf   TEMP,c
+        movlw   ROMLEN*NROMS
+        cpfslt  PFIDX,b             ; Skip while table bytes are left
+        bra     PFDONE
+        movf    PFIDX,w,b
+        rcall   PFREAD
+        movwf   TEMP,c
+        lfsr    1,ROMDAT
+        movf    PFIDX,w,b
+        movff   TEMP,PLUSW1
+        incf    PFIDX,f,b           ; Commit
+        return
+PFDONE:
+        movff   TEMP,PFCUR
+        tstfsz  TEMP,c              ; Skip for the flash table
+        bra     PFDN1
+        movlw   ROMLEN*(NROMS+1)
+        rcall   PFREAD
+        xorlw   BOOTREC
+        bz      PFDN1               ; Stored by COMMIT, ready to serve
+        call    HABUILD             ; Set the ADDR bytes, again if cut short
+PFDN1:
+        clrf    PFREQ,b             ; Commit
+        return
+
+;*******************************************************************************
+; Read byte WREG of ROM profile TEMP into WREG, from the config sector for
+; profile 0 and from data EEPROM for the others. NVMREG also steers tblrd, so
+; interrupts are off while it points to the EEPROM, unless INITDEV has them
+; off already.
+;*******************************************************************************
+PFREAD:
+        tstfsz  TEMP,c              ; Skip for the flash table
+        bra     PFRDEE
+        clrf    PTROWN,b            ; TBLPTR is taken
+        addlw   low(ROM1)
+        movwf   TBLPTRL,c
+        movlw   high(ROM1)
+        movwf   TBLPTRH,c
+        clrf    TBLPTRU,c
+        tblrd   *
+        movf    TABLAT,w,c
+        return
+PFRDEE:
+        movwf   NVMADRL,c
+        decf    TEMP,w,c            ; Profile to address bits 9..7
+        mullw   0x80
+        movf    PRODL,w,c
+        iorwf   NVMADRL,f,c
+        movff   PRODH,NVMADRH
+        btfss   GIEH                ; Skip if interrupts are on
+        bra     PFRD0
+        bcf     GIEH                ; disable interrupts
+        clrf    NVMCON1,c           ; Point to data EEPROM
+        bsf     RD                  ; Read EEPROM byte
+        bsf     NVMREG1             ; access Program Flash Memory
+        bsf     GIEH
+        bra     PFRD1
+PFRD0:
+        clrf    NVMCON1,c           ; Point to data EEPROM
+        bsf     RD                  ; Read EEPROM byte
+        bsf     NVMREG1             ; access Program Flash Memory
+PFRD1:
+        movf    NVMDAT,w,c
+        return
+#endif
 
 ;*******************************************************************************
 ; COMMAND DISPATCH TASK
@@ -1058,50 +2460,80 @@ ID:
 ; RESPOND TO PC WRITE COMMAND
 ; This command begins by waiting for the start of a read/write cycle
 ; where STRn goes low. The Command Bus will be in the input state.
-; Always increment the PC register, even though no data is written.
+; Only nibbles written to the MMIO window are kept. They go to the MMIO
+; register file, one nibble per STRn cycle until the next CDn ends the burst.
+; The PC register follows the Saturn, and the register index is taken from
+; its nibbles 1..0, so a burst wraps around at the end of the 256 nibble
+; window.
 ; The TBLPTR should also be incremented as well when multiple ROMs are added.
 ;*******************************************************************************
 PCWRITE:
-        NEGEDGE STRn                ; 2~4 + 11 instruction cycles (!)
+        NEGEDGE STRn                ; 2~4 + 13 instruction cycles (!)
         btfss   MIOVLD,0,c          ; Skip if MMIO selected
+#ifdef  RAMDEV
+        bra     PCWRAM
+#else
+        bra     IDLE
+#endif
+        btfss   PRANGE,dtMIO,c      ; Skip if in the MMIO page
+#ifdef  RAMDEV
+        bra     PCWRAM
+#else
         bra     IDLE
-        lfsr    1,ROMNUM            ; MMIO buffer pointer
-        movf    PCREG,w,c           ; MMIO address offset
-        andlw   MMIOMASK            ; 16 registers in MMIO
-        addwf   FSR1L,f,c           ; Bump MMIO buffer pointer
+#endif
+        lfsr    1,MIOFILE           ; MMIO register file pointer
+        TLINC   TLCNT+2*cmdPCWRITE  ; 2~3 instruction cycles
+PCWRLP:
+        movff   PCREG,FSR1L         ; Register addressed by nibbles 1..0
         ;FLAGHI
-        POSEDGE STRn                ; 2~4 + 3 (+ 9) instruction cycles
+        POSEDGE STRn                ; 2~4 + 4 instruction cycles
         BUSRD
-        ;movwf   ROMNUM              ; Just update ROM # for now
-        movwf   POSTINC1,c          ; Save
+        movwf   INDF1,c             ; Save
+        incf    PCREG,f,c           ; Next nibble of the burst
         ;FLAGLO
-        bra     IDLE                ; Ignore remaining nibbles
+        NEGEDGE STRn                ; 2~4 + 4 instruction cycles
+        bra     PCWRLP              ; Until CDn ends the burst
     
 
 ;*******************************************************************************
 ; RESPOND TO DP WRITE COMMAND
 ; This command begins by waiting for the start of a read/write cycle
 ; where STRn goes low. The Command Bus will be in the input state.
-; Always increment the DP register, even though no data is written.
+; Only nibbles written to the MMIO window are kept. They go to the MMIO
+; register file, one nibble per STRn cycle until the next CDn ends the burst.
+; The DP register follows the Saturn, and the register index is taken from
+; its nibbles 1..0, so a burst wraps around at the end of the 256 nibble
+; window.
 ; The TBLPTR should also be incremented as well when multiple ROMs are added.
 ;*******************************************************************************
 DPWRITE:
         ;FLAGHI
-        NEGEDGE STRn                ; 2~4 + 11 instruction cycles (!)
+        NEGEDGE STRn                ; 2~4 + 13 instruction cycles (!)
         ;FLAGLO
         btfss   MIOVLD,0,c          ; Skip if MMIO not selected
+#ifdef  RAMDEV
+        bra     DPWRAM
+#else
+        bra     IDLE
+#endif
+        btfss   DRANGE,dtMIO,c      ; Skip if in the MMIO page
+#ifdef  RAMDEV
+        bra     DPWRAM
+#else
         bra     IDLE
-        lfsr    1,ROMNUM            ; MMIO buffer pointer
-        movf    DPREG,w,c           ; MMIO address offset
-        andlw   MMIOMASK            ; 16 registers in MMIO
-        addwf   FSR1L,f,c           ; Bump MMIO buffer pointer
+#endif
+        lfsr    1,MIOFILE           ; MMIO register file pointer
+        TLINC   TLCNT+2*cmdDPWRITE  ; 2~3 instruction cycles
+DPWRLP:
+        movff   DPREG,FSR1L         ; Register addressed by nibbles 1..0
         FLAGHI
-        POSEDGE STRn                ; 2~4 + 3 (+ 9) instruction cycles
+        POSEDGE STRn                ; 2~4 + 4 instruction cycles
         BUSRD
-        ;movwf   ROMNUM              ; Just update ROM # for now
-        movwf   POSTINC1,c          ; Save
+        movwf   INDF1,c             ; Save
+        incf    DPREG,f,c           ; Next nibble of the burst
         FLAGLO
-        bra     IDLE                ; Ignore remaining nibbles
+        NEGEDGE STRn                ; 2~4 + 4 instruction cycles
+        bra     DPWRLP              ; Until CDn ends the burst
 
 ;*******************************************************************************
 ; RESPOND TO LOAD PC COMMAND
@@ -1110,10 +2542,19 @@ DPWRITE:
 ; Load the TBLPTR register as well to point to flash memory image.
 ;*******************************************************************************
 LOADPC:          ; Specifically for 16KB ROM images
+        bcf     PTROWN,ownPC,b      ; Live TBLPTR is stale for the new PC
+        HEATCNT PRANGE              ; 3~10 IC, the previous LOAD PC
+        TLINC   TLCNT+2*cmdLOADPC   ; 2~3 instruction cycles
+        TROPEN                      ; 12 instruction cycles
         ;FLAGHI
         LOADREG PCREG,PPTR,PRANGE
+        TRADDR  PCREG               ; 6 instruction cycles
         ;FLAGLO
+#ifdef  TELEM
+        bra     PCDMY               ; Counted as a LOAD PC already
+#else
         ;bra     PCREAD             ; Just fall through
+#endif
     
 ;*******************************************************************************
 ; RESPOND TO PC READ COMMAND
@@ -1124,37 +2565,55 @@ LOADPC:          ; Specifically for 16KB ROM images
 ; For multiple ROM chips, TBLPTR will also need to always be incremented.
 ;*******************************************************************************
 PCREAD:
-        ; First read cycle is a dummy cycle
-        NEGEDGE STRn                ; 2~4 + 15 instruction cycles (!)
-        movlw   0x00
-        cpfsgt  PRANGE,c            ; Don't output if ROM not selected
+        TLINC   TLCNT+2*cmdPCREAD   ; 2~3 instruction cycles
+PCDMY:
+        ; First read cycle is a dummy cycle. Fetch the first nibble in its low
+        ; half and stage it in its high half, see Sequential Read Engine.
+        NEGEDGE STRn                ; 2~4 + 7/16 instruction cycles (!)
+        btfsc   PRANGE,dtMIO,c      ; Skip if not the MMIO page
+        bra     PCMIO
+PCROM:
+        btfss   PRANGE,dtROM,c      ; Don't output if ROM not selected
+#ifdef  RAMDEV
+        bra     PCRAM
+#else
         bra     IDLE
-        FLAGHI
-        PTRLOAD PPTR
+#endif
+        btfsc   PTROWN,ownPC,b      ; Skip if TBLPTR is not live for PC
+        bra     PCLIVE
+        PTRLOAD PPTR                ; Switching registers, reload TBLPTR
         tblrd   *
         btfsc   PCREG,0,c           ; Even or odd nibble (skip if even)
         swapf   TABLAT,f,c          ; Odd nibble is high nibble of PFM byte
-        movff   TABLAT,CMDLAT       ; Transfer FPM byte to WREG
-        FLAGLO
-        POSEDGE STRn                ; Make sure!
-DMYPCRD:
-        ; Merge two half cycles because of timing (2~4 + 17/18 IC)
-        ;FASTOUT                    ; 4~7 + 2 instruction cycles
-        NEGEDGE STRn                ; 2~4 + 7/8 instruction cycles
+PCLIVE:
+        POSEDGE STRn                ; Make sure! 2~4 + 4 before the engine
+        movff   TABLAT,CMDLAT       ; Stage the first nibble
+        movlw   (1<<ownPC)          ; TBLPTR/TABLAT now follow the PC register
+        movwf   PTROWN,b
+        btfsc   PCREG,0,c           ; Enter the engine at the PCREG nibble phase
+        bra     PCRDO
+PCRDE:
+        ; Even nibble staged in CMDLAT (2~4 + 3, 2~4 + 4 IC)
+        NEGEDGE STRn                ; 2~4 + 3 instruction cycles
         DATAOUT
-        ; Output nibble at start of read cycle
-        incf    PCREG,f,c
-        btfss   PCREG,0,c           ; Skip if PCREG incremented to odd
-        tblrd   +*
-        btfsc   PCREG,0,c           ; Even or odd nibble (skip if even)
+        incf    PCREG,f,c           ; PCREG now odd
         swapf   TABLAT,f,c          ; Odd nibble is high nibble of PFM byte
-        ; Never merge a NEGEDGE! STRn can get stretched
-        ;POSEDGE STRn               ; 2~4 + 12 instruction cycles (!)
-        PTRSAVE PPTR                ; Save latest value
+        POSEDGE STRn                ; 2~4 + 4 instruction cycles
         DATAIN
-        movff   TABLAT,CMDLAT       ; Transfer FPM byte to WREG
-        bra DMYPCRD
-    
+        movff   TABLAT,CMDLAT       ; Stage odd nibble
+PCRDO:
+        ; Odd nibble staged in CMDLAT (2~4 + 10, 2~4 + 6/8 IC)
+        NEGEDGE STRn                ; 2~4 + 10 instruction cycles
+        DATAOUT
+        incf    PCREG,f,c           ; PCREG now even
+        tblrd   +*                  ; Next PFM byte
+        PTRSAVE PPTR                ; Once per PFM byte
+        SLPROBE slPCR
+        POSEDGE STRn                ; 2~4 + 6 (8 with SLACK)
+        DATAIN
+        movff   TABLAT,CMDLAT       ; Stage even nibble
+        bra     PCRDE
+
 
 ;*******************************************************************************
 ; RESPOND TO LOAD DP COMMAND
@@ -1163,11 +2622,19 @@ DMYPCRD:
 ; Load the TBLPTR register as well to point to flash memory image.
 ;*******************************************************************************
 LOADDP:         ; Specifically for 16KB ROM images
+        bcf     PTROWN,ownDP,b      ; Live TBLPTR is stale for the new DP
+        HEATCNT DRANGE              ; 3~10 IC, the previous LOAD DP
+        TLINC   TLCNT+2*cmdLOADDP   ; 2~3 instruction cycles
+        TROPEN                      ; 12 instruction cycles
         ;FLAGHI
         LOADREG DPREG,DPTR,DRANGE
-        ; 11 instruction cycles following last nibble
+        TRADDR  DPREG               ; 6 instruction cycles
         ;FLAGLO
+#ifdef  TELEM
+        bra     DPDMY               ; Counted as a LOAD DP already
+#else
         ;bra     DPREAD             ; Just fall through
+#endif
     
 ;*******************************************************************************
 ; RESPOND TO DP READ COMMAND
@@ -1177,36 +2644,169 @@ LOADDP:         ; Specifically for 16KB ROM images
 ; assigned ROM address range, which is ADDR to ADDR+ROMSIZE-1.
 ;*******************************************************************************
 DPREAD:
-        NEGEDGE STRn                ; 2~4 + 15 instruction cycles (!)
-        movlw   0x00
-        cpfsgt  DRANGE,c            ; Don't output if ROM not selected
+        TLINC   TLCNT+2*cmdDPREAD   ; 2~3 instruction cycles
+DPDMY:
+        ; First read cycle is a dummy cycle. Fetch the first nibble in its low
+        ; half and stage it in its high half, see Sequential Read Engine.
+        NEGEDGE STRn                ; 2~4 + 7/16 instruction cycles (!)
+        btfsc   DRANGE,dtMIO,c      ; Skip if not the MMIO page
+        bra     DPMIO
+DPROM:
+        btfss   DRANGE,dtROM,c      ; Don't output if ROM not selected
+#ifdef  RAMDEV
+        bra     DPRAM
+#else
         bra     IDLE
-        FLAGHI
-        PTRLOAD DPTR
+#endif
+        btfsc   PTROWN,ownDP,b      ; Skip if TBLPTR is not live for DP
+        bra     DPLIVE
+        PTRLOAD DPTR                ; Switching registers, reload TBLPTR
         tblrd   *
         btfsc   DPREG,0,c           ; Even or odd nibble (skip if even)
         swapf   TABLAT,f,c          ; Odd nibble is high nibble of PFM byte
-        movff   TABLAT,CMDLAT       ; Transfer FPM byte to WREG
-        FLAGLO
-        POSEDGE STRn                ; Make sure!
-DMYDPRD:
-        ; Merge two half cycles because of timing (2~4 + 17/18 IC)
-        ;FASTOUT                    ; 4~7 + 2 instruction cycles
-        NEGEDGE STRn                ; 2~4 + 7/8 instruction cycles
+DPLIVE:
+        POSEDGE STRn                ; Make sure! 2~4 + 4 before the engine
+        movff   TABLAT,CMDLAT       ; Stage the first nibble
+        movlw   (1<<ownDP)          ; TBLPTR/TABLAT now follow the DP register
+        movwf   PTROWN,b
+        btfsc   DPREG,0,c           ; Enter the engine at the DPREG nibble phase
+        bra     DPRDO
+DPRDE:
+        ; Even nibble staged in CMDLAT (2~4 + 3, 2~4 + 4 IC)
+        NEGEDGE STRn                ; 2~4 + 3 instruction cycles
         DATAOUT
-        ; Output nibble at start of read cycle
-        incf    DPREG,f,c
-        btfss   DPREG,0,c           ; Skip if incremented DPREG to odd
-        tblrd   +*
-        btfsc   DPREG,0,c           ; Even or odd nibble (skip if even)
+        incf    DPREG,f,c           ; DPREG now odd
         swapf   TABLAT,f,c          ; Odd nibble is high nibble of PFM byte
-        ; Never merge a NEGEDGE! STRn can get stretched
-        ;POSEDGE STRn               ; 2~4 + 12 instruction cycles (!)
-        PTRSAVE DPTR                ; Save latest value
+        POSEDGE STRn                ; 2~4 + 4 instruction cycles
         DATAIN
-        movff   TABLAT,CMDLAT       ; Transfer FPM byte to WREG
-        bra     DMYDPRD
-    
+        movff   TABLAT,CMDLAT       ; Stage odd nibble
+DPRDO:
+        ; Odd nibble staged in CMDLAT (2~4 + 10, 2~4 + 6/8 IC)
+        NEGEDGE STRn                ; 2~4 + 10 instruction cycles
+        DATAOUT
+        incf    DPREG,f,c           ; DPREG now even
+        tblrd   +*                  ; Next PFM byte
+        PTRSAVE DPTR                ; Once per PFM byte
+        SLPROBE slDPR
+        POSEDGE STRn                ; 2~4 + 6 (8 with SLACK)
+        DATAIN
+        movff   TABLAT,CMDLAT       ; Stage even nibble
+        bra     DPRDE
+
+
+;*******************************************************************************
+; RESPOND TO PC READ OR DP READ IN THE MMIO WINDOW
+; Entered from PCREAD/DPREAD in the low half of the dummy cycle when the
+; register points into the MMIO page. Outside the 256 nibble window the page is
+; served from flash as usual. Inside it, MIORD returns one register of MIOFILE
+; per STRn cycle until the next CDn, advancing the register as the Saturn does.
+; FSR0 points to PCREG or DPREG. TBLPTR is not used, PTROWN stays valid.
+;*******************************************************************************
+PCMIO:
+        btfss   MIOVLD,0,c          ; Skip if in the MMIO window
+        bra     PCROM
+        lfsr    0,PCREG
+        bra     MIORD
+DPMIO:
+        btfss   MIOVLD,0,c          ; Skip if in the MMIO window
+        bra     DPROM
+        lfsr    0,DPREG
+MIORD:
+        lfsr    1,MIOFILE           ; MMIO register file pointer
+        movff   INDF0,FSR1L         ; Register addressed by nibbles 1..0
+        movff   INDF1,CMDLAT        ; Stage first nibble
+        POSEDGE STRn                ; Make sure! Dummy cycle at 2~4 + 15
+MIORLP:
+        NEGEDGE STRn                ; 2~4 + 4 instruction cycles
+        DATAOUT
+        incf    INDF0,f,c           ; Next nibble of the burst
+        movff   INDF0,FSR1L
+        POSEDGE STRn                ; 2~4 + 6 instruction cycles
+        DATAIN
+        movff   INDF1,CMDLAT        ; Stage next nibble
+        bra     MIORLP
+
+#ifdef  RAMDEV
+;*******************************************************************************
+; RESPOND TO PC/DP READ AND WRITE OF THE RAM DEVICE
+; Reached from the PC/DP handlers when the decode entry is not a ROM page.
+; FSR0 points at the PC or DP register, FSR1 walks the SRAM copy of the RAM.
+; The register is incremented with a carry into nibble 2 so that the next
+; burst starts where this one stopped. See RAM Device above.
+;*******************************************************************************
+PCRAM:
+        btfss   PRANGE,dtRAM,c      ; Skip if the RAM device page
+        bra     IDLE
+        lfsr    0,PCREG
+        bra     RAMRD
+DPRAM:
+        btfss   DRANGE,dtRAM,c      ; Skip if the RAM device page
+RAMOUT:
+        bra     IDLE                ; IDLE is out of reach of bnz below
+        lfsr    0,DPREG
+RAMRD:
+        ; Dummy cycle at 2~4 + 11, finish it in the high half
+        POSEDGE STRn                ; 2~4 + 13 instruction cycles (!)
+        RAMPTR                      ; 10 instruction cycles
+        bnz     RAMOUT              ; Elsewhere in the page
+        movff   INDF1,CMDLAT        ; Stage first nibble
+RAMRLP:
+        NEGEDGE STRn                ; 2~4 + 5 instruction cycles
+        DATAOUT
+        movf    POSTINC1,w,c        ; Next RAM nibble
+        movlw   0x01
+        infsnz  INDF0,f,c           ; Next nibble of the burst
+        incf    PLUSW0,f,c          ; Carry into nibbles 3..2
+        movlw   high(RAMBUF)+4
+        cpfslt  FSR1H,c             ; Skip while inside the RAM device
+        bra     RAMREND
+        POSEDGE STRn                ; 2~4 + 9 instruction cycles
+        DATAIN
+        movff   INDF1,CMDLAT        ; Stage next nibble
+        bra     RAMRLP
+RAMREND:
+        ; Last nibble of the RAM device is on the bus, release it and stop
+        POSEDGE STRn                ; 2~4 + 10 instruction cycles
+        DATAIN
+        bra     IDLE
+
+PCWRAM:
+        btfsc   PRANGE,dtROM,c      ; Skip unless a ROM page
+        bra     IDLE
+        btfss   PRANGE,dtRAM,c      ; Skip if the RAM device page
+        bra     IDLE
+        lfsr    0,PCREG
+        bra     RAMWR
+DPWRAM:
+        btfsc   DRANGE,dtROM,c      ; Skip unless a ROM page
+        bra     IDLE
+        btfss   DRANGE,dtRAM,c      ; Skip if the RAM device page
+        bra     IDLE
+        lfsr    0,DPREG
+RAMWR:
+        bsf     RAMFLG,rfDIRTY,b    ; EEPROM copy is out of date
+        POSEDGE STRn                ; 2~4 + 18 instruction cycles (!)
+        BUSRD
+        movwf   TEMP,c              ; First nibble, pointer not yet known
+        RAMPTR                      ; 10 instruction cycles
+        bnz     RAMOUT              ; Elsewhere in the page
+        movff   TEMP,POSTINC1       ; Save
+        bra     RAMWNX
+RAMWLP:
+        POSEDGE STRn                ; 2~4 + 6 instruction cycles
+        BUSRD
+        movwf   POSTINC1,c          ; Save
+RAMWNX:
+        NEGEDGE STRn                ; 2~4 + 5 instruction cycles
+        movlw   0x01
+        infsnz  INDF0,f,c           ; Next nibble of the burst
+        incf    PLUSW0,f,c          ; Carry into nibbles 3..2
+        movlw   high(RAMBUF)+4
+        cpfslt  FSR1H,c             ; Skip while inside the RAM device
+        bra     IDLE                ; Past the end, ignore the rest
+        bra     RAMWLP              ; Until CDn ends the burst
+#endif
+
 
 ;*******************************************************************************
 ; RESPOND TO CONFIGURE COMMAND
@@ -1290,6 +2890,21 @@ SHUTDWN:
         ;FLAGHI
         ;NEGEDGE STRn
         ;FLAGLO
+#ifdef  RAMDEV
+        btfss   RAMFLG,rfDIRTY,b    ; Skip if the RAM device was written
+        bra     SHUTEND
+        bcf     RAMFLG,rfDIRTY,b
+        bsf     RAMFLG,rfSAVE,b     ; Idle task writes it back to EEPROM
+        clrf    RAMIDX,b
+        clrf    RAMIDX+1,b
+SHUTEND:
+#endif
+#ifdef  POWERMGT
+#ifdef  TELEM
+        call    TLIDLE              ; A nap can end in Sleep
+#endif
+        bra     PMNAP               ; Nap until the next bus command
+#endif
         bra     IDLE
     
 
@@ -1304,6 +2919,7 @@ RESETX:
         ; 5 instruction cycles following command dispatch
         ;FLAGHI
         ;FLAGLO
+        TLINC   TLCNT+2*cmdRESET
         goto    INITDEV
 
 
@@ -1332,6 +2948,20 @@ INITMOD:
         bcf     SYSCMD              ; Enable System Clock Network
         bcf     NVMMD               ; Enable NVM Module
         bcf     IOCMD               ; Enable Interrupt on Change
+        bcf     TMR1MD              ; Enable Timer1
+#ifdef  POWERMGT
+        bcf     TMR0MD              ; Enable Timer0
+#endif
+#ifdef  BUSTRACE
+        bcf     TMR3MD              ; Enable Timer3
+#endif
+#ifdef  SLACK
+        bcf     TMR2MD              ; Enable Timer2
+#endif
+#ifdef  SCRUB
+        bcf     CRCMD               ; Enable the CRC module
+        bcf     SCANMD              ; Enable the memory scanner
+#endif
 ; Taken from mcc_generated_files/pin_manager.c
         banksel LATA
         clrf    LATA,b              ; Clear all port output latches
@@ -1396,6 +3026,51 @@ INITMOD:
         movlw   0x1F                ; Maximum frequency
         movwf   OSCTUNE,b           ; Recommended by Diego Diaz
 
+        ; Timer1 counts instruction cycles for bus timing measurements
+        banksel T1CON
+        movlw   0x01                ; Clock source Fosc/4
+        movwf   T1CLK,b
+        movlw   0x03                ; 16-bit read, prescale 1:1, timer on
+        movwf   T1CON,b
+#ifdef  POWERMGT
+        clrf    T1GATE,b            ; Gate from the T1G pin, CDn after a nap
+        banksel T1GPPS
+        movlw   0x04                ; RA4->TMR1:T1G
+        movwf   T1GPPS,b
+#endif
+#ifdef  BUSTRACE
+        ; Timer3 time stamps the bus trace, TMR3H is read directly
+        banksel T3CON
+        movlw   0x01                ; Clock source Fosc/4
+        movwf   T3CLK,b
+        movlw   0x01                ; 8-bit read, prescale 1:1, timer on
+        movwf   T3CON,b
+#endif
+#ifdef  SLACK
+        ; Timer2 counts instruction cycles since the last STRn edge
+        banksel T2INPPS
+        movlw   0x03                ; RA3->TMR2:T2IN
+        movwf   T2INPPS,b
+        banksel T2CON
+        movlw   0x01                ; Clock source Fosc/4
+        movwf   T2CLKCON,b
+        clrf    T2RST,b             ; Reset source is T2INPPS
+        movlw   0x03                ; Reset on either edge
+        movwf   T2HLT,b
+        setf    T2PR,b              ; Full 8-bit count
+        movlw   0x80                ; Prescale 1:1, postscale 1:1, timer on
+        movwf   T2CON,b
+#endif
+#ifdef  POWERMGT
+        ; Timer0 counts seconds from LFINTOSC, also in Sleep
+        banksel T0CON1
+        movlw   0x9f                ; LFINTOSC, asynchronous, prescale 1:32768
+        movwf   T0CON1,b
+        setf    TMR0H,b             ; 8-bit period of 256 seconds
+        movlw   0x80                ; Timer on, 8-bit, postscale 1:1
+        movwf   T0CON0,b
+#endif
+
         ; Interrupt configuration (CDn fall, Din rise)
 ; From interrupt_manager.c, INTERRUPT_Initialize()
 ;        banksel INTCON0
@@ -1405,6 +3080,9 @@ INITMOD:
         banksel IPR0
         bsf     INT0IP              ; INT0I - high priority
         bcf     INT1IP              ; INT1I - low priority
+#ifdef  POWERMGT
+        bcf     TMR0IP              ; TMR0I - low priority, ends a nap only
+#endif
 ; From pinmanager.c, PIN_MANAGER_Initialize()
         banksel IOCAF
         ; CDn interrupt on falling edge
@@ -1480,6 +3158,28 @@ INITMOD:
         andwf   TRISB,f,c           ; Clear bits 4-7
 #endif   ; end of #ifdef SERMON
 ;//</editor-fold>
+#ifdef  SPILIB
+        ; Configure the MSSP as SPI master for the library flash
+        banksel PMD4
+        bcf     MSSP1MD             ; Enable MSSP1
+        bsf     SPILAT,SPICS,c      ; Deselect the flash
+        banksel TRISC
+        bsf     TRISC,4,b           ; MSSP1 RC4 is SDI, disable output
+        banksel RC3PPS
+        movlw   0x0d                ; RC3->MSSP1:SCK1
+        movwf   RC3PPS,b
+        movlw   0x0e                ; RC1->MSSP1:SDO1
+        movwf   RC1PPS,b
+        movlw   0x13                ; RC3->MSSP1:SCK1, master clocks itself
+        movwf   SSP1CLKPPS,b
+        movlw   0x14                ; RC4->MSSP1:SDI1
+        movwf   SSP1DATPPS,b
+        banksel SSP1STAT
+        movlw   0x40                ; Sample in middle, transmit on falling
+        movwf   SSP1STAT,b          ; SCK edge, SPI mode 0
+        movlw   0x20                ; SPI enabled, master, clock Fosc/4
+        movwf   SSP1CON1,b
+#endif
 #ifdef _PIC18F27K40_INC_
         ; Seems to be needed, at least at initialization
         bcf      NVMREG0
@@ -1498,8 +3198,77 @@ INITMOD:
 ;*******************************************************************************
 HARDRST:
         banksel CMD                 ; Default for all BSR accesses
-        movlw   0x00                ; No ROM configuration is active
-        movwf   ROMNUM,c
+        lfsr    1,MIOFILE           ; Clear the MMIO register file
+        clrf    POSTINC1,c          ; No ROM configuration is active
+        tstfsz  FSR1L,c             ; Skip when the page is done
+        bra     $-4
+#ifdef  RAMDEV
+        call    RAMINIT             ; RAM device ID entry and contents
+#endif
+#ifdef  COPROC
+        clrf    CPSTA,b             ; No coprocessor request under way
+        clrf    CPSTA+CPLEN,b
+#endif
+#ifdef  BRIDGE
+        clrf    RXIN,b              ; Serial bridge rings are empty
+        clrf    RXOUT,b
+        clrf    TXIN,b
+        clrf    TXOUT,b
+#endif
+#ifdef  LIVEMON
+        clrf    LMCHR,b             ; No live monitor command under way
+        clrf    LMCMD,b
+        clrf    LMIN,b
+        clrf    LMOUT,b
+#endif
+#ifdef  POWERMGT
+        clrf    NVMCON1,c           ; Point to data EEPROM
+        movlw   low(PMEEADR)
+        movwf   NVMADRL,c
+        movlw   high(PMEEADR)
+        movwf   NVMADRH,c
+        bsf     RD                  ; Read EEPROM byte
+        movff   NVMDAT,PMTMO        ; Idle timeout in seconds
+        bsf     NVMREG1             ; access Program Flash Memory
+        clrf    PMFLG,b
+        movff   TMR0L,PMSEC
+        lfsr    1,PMON              ; Clear the power state counters
+        movlw   8
+        clrf    POSTINC1,c
+        decfsz  WREG,f,c
+        bra     $-4
+        clrf    PMNAPW,b
+#endif
+        clrf    ENLATE,b            ; No late enumeration seen yet
+#ifdef  PROFILE
+        clrf    PFCUR,b             ; Table from flash, no copy under way
+        clrf    PFREQ,b
+#endif
+#ifdef  SCRUB
+        clrf    SCBAD,b             ; No block failed the scrub yet
+        movlw   (1<<scOFF)          ; Off until the CRCs are found
+        movwf   SCST,b
+#endif
+#ifdef  TELEM
+        lfsr    1,TLCNT             ; Clear the telemetry counters
+        movlw   low(TLIDX+1)
+        clrf    POSTINC1,c
+        cpfseq  FSR1L,c             ; Skip after TLIDX
+        bra     $-4
+#endif
+#ifdef  SLACK
+        call    SLINIT
+#endif
+#ifdef  HEATMAP
+        call    HMINIT
+#endif
+#ifdef  BUSTRACE
+        lfsr    1,TRRING            ; Clear the bus trace ring
+        clrf    POSTINC1,c
+        tstfsz  FSR1L,c             ; Skip when the page is done
+        bra     $-4
+        clrf    TRIDX,b
+#endif
         ; Initialize static variables
         movlw   ROMLEN              ; Length of ROM configuration string
         mullw   NROMS+1             ; Extra ROM entry for MMIO address
@@ -1516,7 +3285,22 @@ HALOOP:
         movwf   POSTINC0,c          ; Store to RAM
         decfsz  CNTR,f,c            ; Done when counter is zero
         bra     HALOOP
-
+        tblrd   *+                  ; Boot record follows the table
+        movlw   BOOTREC
+        cpfseq  TABLAT,c            ; Skip if written by COMMIT
+        bra     HABUILD
+#ifdef  SCRUB
+        lfsr    0,SCREF             ; Block CRCs follow the boot record
+        movlw   0x10
+        movwf   CNTR,c
+        tblrd   *+
+        movff   TABLAT,POSTINC0
+        decfsz  CNTR,f,c
+        bra     $-8
+        clrf    SCST,b              ; Scrub from block 0
+#endif
+        return                      ; Table is ready to serve as stored
+HABUILD:
         ; Initialize ROM table entry values in RAM
         lfsr    0,ROMDAT            ; Transfer target address
         movlw   NROMS               ; Number of ROM table entries
@@ -1525,17 +3309,8 @@ HALOOP2:
         movlw   teFLAG
         btfsc   PLUSW0,teHARD,0     ; See if we've reached the hard ROM entries
         bra     HAROMS              ; Finish up the two hard rom entries
-        movlw   teBANK
-        movff   PLUSW0,TEMP         ; Read PFM block number to TEMP
-        rrncf   TEMP,c              ; Rotate right 3 times to form ADDR byte
-        rrncf   TEMP,c
-        rrncf   TEMP,c
-        movlw   0x00
-        cpfseq  TEMP,c              ; Addressing PFM block 0?
-        bra     HA1_7
-        movlw   0x10                ; ADDR byte for 8K ROM in block 0
+        call    BANKMAP             ; Form ADDR byte from the PFM block
         movwf   TEMP,c
-HA1_7:
         movlw   teADDR
         movff   TEMP,PLUSW0         ; Update ADDR byte
         movlw   ROMLEN              ; Length of a ROM table entry
@@ -1564,6 +3339,9 @@ INITVAR:
         clrf    RDY,c
         clrf    MIOVLD,c
         clrf    IDSENT,c            ; Haven't responded to ID command
+        clrf    PTROWN,b            ; No register owns TBLPTR
+        clrf    TIMPRF,b            ; Conservative timing until measured
+        clrf    TIMCNT,b
         lfsr    0,ROMDAT            ; Point to first ROM entry
         lfsr    1,ROMDAT            ; Point to first ROM entry bank number
         return
@@ -1571,19 +3349,734 @@ INITVAR:
 
 ;*******************************************************************************
 ; SOFT RESET 2
-; Initialize address mapping table
+; Initialize address decode table
+; The table has one entry for each 4K nibble page of the Saturn address space,
+; indexed by address bits 19..12. LOADREG adds nibble 4 shifted up as a signed
+; PLUSW2 offset to FSR2 = DECTBL + 0x80 + nibble 3, so the entry for page P is
+; kept at DECTBL + (P xor 0x80). The clear is unrolled, enumeration commands
+; can follow Din closely.
 ;*******************************************************************************
 INITTAB:
-        ; Set up & initialize address mapping table
-        lfsr    2,MAPTBL            ; Base address of mapping table
-        movlw   0x20                ; 32 table entries
+        lfsr    1,DECTBL            ; Base address of decode table
 MPTBLP:
-        clrf    PLUSW2,0            ; Clear table entry
-        decfsz  WREG,c
+        clrf    POSTINC1,c          ; Clear 8 table entries
+        clrf    POSTINC1,c
+        clrf    POSTINC1,c
+        clrf    POSTINC1,c
+        clrf    POSTINC1,c
+        clrf    POSTINC1,c
+        clrf    POSTINC1,c
+        clrf    POSTINC1,c
+        tstfsz  FSR1L,c             ; Done when pointer reaches the next page
         bra     MPTBLP
-        clrf    PLUSW2,0            ; Clear last table entry
+        lfsr    2,DECTBL+0x80       ; LOADREG only sets FSR2L
+        return
+
+;*******************************************************************************
+; Point FSR1 to the decode table entry for the 4K page in WREG
+;*******************************************************************************
+DECPTR:
+        lfsr    1,DECTBL
+        xorlw   0x80                ; Entries are kept around the middle
+        movwf   FSR1L,c
+        return
+
+;*******************************************************************************
+; Fill the eight decode table entries of a 16K PFM block
+; WREG holds the mapping byte, the PFM block number in bits 7..5 and bit 4 set
+; for an image starting in the upper half of the block, which is an 8K image
+; and is mirrored in the upper half of its 16K window. FSR1 points to the
+; entry of the first 4K page and is left pointing past the last one.
+; MAP8K fills only the four entries of the 8K half the mapping byte points to.
+;*******************************************************************************
+MAPCHIP:
+        rcall   MAP8K               ; First 8K
+        btfsc   MAPVAL,4,c          ; Skip unless 8K image, mirror it
+        movf    TEMP,w,c
+        bra     MAPHALF
+MAP8K:
+        movwf   MAPVAL,c
+        rlncf   MAPVAL,w,c          ; TBLPTRH bits 7..5 of the 8K half
+        andlw   0xe0
+        btfsc   MAPVAL,7,c          ; Skip if in blocks 0..3
+        iorlw   (1<<dtU)
+        iorlw   (1<<dtROM)
+        movwf   TEMP,c
+MAPHALF:
+        movwf   INDF1,c             ; 4 pages, 2KB of PFM each
+        incf    FSR1L,f,c           ; Wrap within the table page
+        addlw   0x08
+        movwf   INDF1,c
+        incf    FSR1L,f,c
+        addlw   0x08
+        movwf   INDF1,c
+        incf    FSR1L,f,c
+        addlw   0x08
+        movwf   INDF1,c
+        incf    FSR1L,f,c
+        addlw   0x08
         return
 
+;*******************************************************************************
+; Form the mapping byte of the ROM table entry at FSR0 from its Bank byte
+; Bits 7..4 hold the 8K half of PFM the image starts in. An 8K image (te8K)
+; is in the upper half of its block unless teLOW is set in the Bank byte, a
+; larger one starts at the block. Block 0 is only used from its upper half.
+; Returns the mapping byte in WREG. Uses TEMP.
+;*******************************************************************************
+BANKMAP:
+        movlw   teBANK
+        movf    PLUSW0,w,c
+        andlw   0x07                ; PFM block number
+        movwf   TEMP,c
+        swapf   TEMP,f,c            ; to bits 7..5
+        rlncf   TEMP,f,c
+        movlw   teID1
+        movf    PLUSW0,w,c          ; ROM size nibble
+        xorlw   te8K
+        bnz     BMAP0               ; Not an 8K image
+        movlw   teBANK
+        btfss   PLUSW0,teLOW,c      ; Skip if in the lower half
+        bsf     TEMP,4,c            ; Upper half of the block
+BMAP0:
+        movf    TEMP,w,c
+        bnz     $+4                 ; Skip unless block 0
+        movlw   0x10                ; Pattern for hidden block 0
+        return
+
+;*******************************************************************************
+; Fill the decode table entries of a hard ROM chip
+; WREG holds its first 4K page, FSR0 points to its table entry. The chip is
+; mapped from the PFM block in its Bank byte, which may also be named by
+; other entries. An 8K chip is mirrored in the upper half of its window only
+; from the upper half of a block.
+;*******************************************************************************
+HRDCHIP:
+        rcall   DECPTR
+        rcall   BANKMAP
+        bra     MAPCHIP
+
+;*******************************************************************************
+; Refresh the read-only status registers of the MMIO register file, one
+; nibble per register, low nibble first. BSR = 0.
+;*******************************************************************************
+MIOSTAT:
+        lfsr    1,MIOFILE+mrSTAT
+        movff   TIMPRF,POSTINC1     ; 10: timing profile
+        movf    STRPER,w,b          ; 11-12: four STRn periods
+        andlw   0x0f
+        movwf   POSTINC1,c
+        swapf   STRPER,w,b
+        andlw   0x0f
+        movwf   POSTINC1,c
+        return
+
+#if defined(COPROC) || defined(BRIDGE)
+;*******************************************************************************
+; Read the byte held in two MMIO registers at FSR0, low nibble first
+;*******************************************************************************
+MIOGET:
+        movf    POSTINC0,w,c
+        movwf   TEMP,c
+        swapf   POSTINC0,w,c
+        iorwf   TEMP,w,c
+        return
+
+;*******************************************************************************
+; Write WREG to two MMIO registers at FSR0, low nibble first
+;*******************************************************************************
+MIOPUT:
+        movwf   TEMP,c
+        andlw   0x0f
+        movwf   POSTINC0,c
+        swapf   TEMP,w,c
+        andlw   0x0f
+        movwf   POSTINC0,c
+        return
+#endif
+
+#ifdef  RAMDEV
+;*******************************************************************************
+; Map the RAM device at the CONFIGURE address, then go on with the ROM table.
+; The RAM device does not count against the NROMS table entries.
+;*******************************************************************************
+RAMMAP:
+        movf    ARANGE,w,c          ; Decode entry of the 4K page
+        call    DECPTR
+        movlw   (1<<dtRAM)
+        iorwf   INDF1,f,c           ; Keep dtMIO if the window is there too
+        movf    ADDR+1,w,c          ; Nibble 2 of the base address
+        andlw   0x0c
+        movwf   RAMN2,b
+        lfsr    0,ROMDAT            ; Point to first ROM entry
+        bra     ENUMCHK
+
+;*******************************************************************************
+; Build the RAM device ID entry and reload its contents from data EEPROM,
+; two nibbles per byte, low nibble first. Erased EEPROM reads back as F.
+;*******************************************************************************
+RAMINIT:
+        lfsr    1,RAMDAT
+        movlw   teRAM1K
+        movwf   POSTINC1,c          ; ID nibble 1, 1K nibbles
+        clrf    POSTINC1,c
+        clrf    POSTINC1,c          ; ID nibble 3, RAM
+        clrf    POSTINC1,c
+        movlw   (1<<teEOM)
+        movwf   POSTINC1,c          ; ID nibble 5, end of module
+        movlw   (1<<teRAM)
+        movwf   POSTINC1,c          ; teFLAG, RAMMAP picks up the ROM table
+        clrf    RAMFLG,b
+        clrf    NVMCON1,c           ; Point to data EEPROM
+        clrf    NVMADRL,c
+        clrf    NVMADRH,c
+        lfsr    1,RAMBUF
+RILOOP:
+        bsf     RD                  ; Read EEPROM byte
+        movf    NVMDAT,w,c
+        andlw   0x0f
+        movwf   POSTINC1,c
+        swapf   NVMDAT,w,c
+        andlw   0x0f
+        movwf   POSTINC1,c
+        incf    NVMADRL,f,c
+        btfsc   CARRY
+        incf    NVMADRH,f,c
+        btfss   NVMADRH,1,c         ; Done at 200h
+        bra     RILOOP
+        bsf     NVMREG1             ; access Program Flash Memory
+        return
+
+;*******************************************************************************
+; Write one byte of the RAM device back to data EEPROM, called by the Idle
+; task while rfSAVE is set. Returns at once while the previous write is still
+; in progress. Interrupts stay on: both ISRs point NVMREG, which also steers
+; tblrd, back to Program Flash Memory, and a byte cut short is simply done
+; again on the next pass, as RAMIDX only moves on at the end. BSR = 0.
+;*******************************************************************************
+RAMSAVE:
+        btfsc   WR                  ; Skip if no write in progress
+        return
+        bcf     CARRY
+        rlcf    RAMIDX,w,b          ; Two nibbles per EEPROM byte
+        movwf   FSR1L,c
+        rlcf    RAMIDX+1,w,b
+        addlw   high(RAMBUF)
+        movwf   FSR1H,c
+        movf    POSTINC1,w,c        ; Low nibble
+        movwf   TEMP,c
+        swapf   INDF1,w,c           ; High nibble
+        iorwf   TEMP,f,c
+        clrf    NVMCON1,c           ; Point to data EEPROM
+        movff   RAMIDX,NVMADRL
+        movff   RAMIDX+1,NVMADRH
+        bsf     RD
+        movf    NVMDAT,w,c
+        cpfseq  TEMP,c              ; Skip if the byte is unchanged
+        bra     RSWRITE
+        bra     RSDONE
+RSWRITE:
+        movff   TEMP,NVMDAT
+        bsf     WREN                ; enable write to memory
+        movlw   0x55
+        movwf   NVMCON2,c
+        movlw   0xAA
+        movwf   NVMCON2,c
+        bsf     WR                  ; Start write, CPU keeps running
+        bcf     WREN                ; disable writes to memory
+RSDONE:
+        bsf     NVMREG1             ; access Program Flash Memory
+        infsnz  RAMIDX,f,b          ; Next byte
+        incf    RAMIDX+1,f,b
+        btfsc   RAMIDX+1,1,b        ; Done at 200h
+        bcf     RAMFLG,rfSAVE,b
+        return
+#endif
+
+#ifdef  COPROC
+;*******************************************************************************
+; MMIO COPROCESSOR
+; Run one step of the kernel requested in the MMIO opcode register. Called by
+; the Idle task while the opcode is not zero. A CDn interrupt can abandon a
+; step at any point, so a step works on CPWORK, loaded from the committed
+; copy of the state, and commits it to the other copy with a single btg of
+; CPSEL. An abandoned step is simply run again. BSR = 0.
+;*******************************************************************************
+CPSTEP:
+        rcall   CPLOAD
+        movff   MIOFILE+mrOP,WREG
+        cpfseq  CPOP,b              ; Skip if this request is under way
+        bra     CPINIT
+        dcfsnz  WREG,f,c
+        bra     CPCRC               ; 1: CRC-16
+        dcfsnz  WREG,f,c
+        bra     CPCRC               ; 2: CRC-32
+        dcfsnz  WREG,f,c
+        bra     CPFIND              ; 3: nibble search
+        dcfsnz  WREG,f,c
+        bra     CPFIND              ; 4: byte search
+        dcfsnz  WREG,f,c
+        bra     CPMUL               ; 5: BCD multiply
+        dcfsnz  WREG,f,c
+        bra     CPDIV               ; 6: BCD divide
+        bra     CPERR               ; Unknown opcode
+
+        ; New request, WREG holds the opcode
+CPINIT:
+        movwf   CPOP,b
+        clrf    CPIDX,b
+        lfsr    0,CPACC
+        movlw   CPLEN-2
+        movwf   TEMP,c
+        clrf    POSTINC0,c          ; Clear the kernel state
+        decfsz  TEMP,f,c
+        bra     $-4
+        movlw   cpFINDB
+        cpfsgt  CPOP,b              ; Skip unless a block kernel
+        bra     CPIBLK
+        movlw   cpDIV
+        cpfseq  CPOP,b              ; Skip for the divide
+        bra     CPSAVE
+        movlw   12                  ; Quotient digit of 10^12 first
+        movwf   CPIDX,b
+        lfsr    0,MIOFILE+mrA       ; Dividend packed into R
+        lfsr    1,CPACC
+        movlw   6
+        movwf   CPJ,b
+        rcall   MIOGET
+        movwf   POSTINC1,c
+        decfsz  CPJ,f,b
+        bra     $-6
+        lfsr    0,MIOFILE+mrBLK     ; Nine's complement of the divisor
+        lfsr    1,CPBC
+        movlw   6
+        movwf   CPJ,b
+        rcall   MIOGET
+        sublw   0x99
+        movwf   POSTINC1,c
+        decfsz  CPJ,f,b
+        bra     $-8
+        movlw   0x99
+        movwf   INDF1,c
+        bra     CPSAVE
+CPIBLK:
+        lfsr    0,MIOFILE+mrLEN
+        rcall   MIOGET              ; Block length in nibbles
+        sublw   0x100-mrBLK         ; No borrow if the block ends in MIOFILE
+        btfss   CARRY
+        bra     CPERR
+        movlw   cpFINDN
+        cpfslt  CPOP,b              ; Skip for a CRC kernel
+        bra     CPSAVE
+CPICRC:
+        setf    CPACC,b             ; Initial value is all ones
+        setf    CPACC+1,b
+        btfss   CPOP,1,b            ; Skip for CRC-32
+        bra     CPSAVE
+        setf    CPACC+2,b
+        setf    CPACC+3,b
+        bra     CPSAVE
+
+;*******************************************************************************
+; CRC-16/X-25 and CRC-32 (IEEE 802.3) of the block, one nibble per step. Both
+; are reflected, so the low nibble of a byte goes first as the 71B stores it.
+; The 16-bit value stays in CPACC+1..0 with the upper bytes zero.
+;*******************************************************************************
+CPCRC:
+        lfsr    0,MIOFILE+mrLEN
+        rcall   MIOGET               ; Block length in nibbles
+        cpfslt  CPIDX,b             ; Skip while nibbles remain
+        bra     CPCRCX
+        lfsr    0,MIOFILE+mrBLK
+        movf    CPIDX,w,b
+        movf    PLUSW0,w,c
+        xorwf   CPACC,f,b
+        movlw   4
+        movwf   TEMP,c
+CPCRCL:
+        bcf     CARRY
+        rrcf    CPACC+3,f,b
+        rrcf    CPACC+2,f,b
+        rrcf    CPACC+1,f,b
+        rrcf    CPACC,f,b
+        bnc     CPCRCN
+        movlw   0x08                ; Polynomial 8408h
+        btfsc   CPOP,1,b
+        movlw   0x20                ; Polynomial EDB88320h
+        xorwf   CPACC,f,b
+        movlw   0x84
+        btfsc   CPOP,1,b
+        movlw   0x83
+        xorwf   CPACC+1,f,b
+        btfss   CPOP,1,b
+        bra     CPCRCN
+        movlw   0xb8
+        xorwf   CPACC+2,f,b
+        movlw   0xed
+        xorwf   CPACC+3,f,b
+CPCRCN:
+        decfsz  TEMP,f,c
+        bra     CPCRCL
+        incf    CPIDX,f,b
+        bra     CPSAVE
+CPCRCX:
+        comf    CPACC,f,b           ; Final XOR
+        comf    CPACC+1,f,b
+        btfsc   CPOP,1,b
+        comf    CPACC+2,f,b
+        btfsc   CPOP,1,b
+        comf    CPACC+3,f,b
+        lfsr    0,MIOFILE+mrRES
+        lfsr    1,CPACC
+        movlw   4
+        movwf   CPJ,b
+        movf    POSTINC1,w,c
+        rcall   MIOPUT
+        decfsz  CPJ,f,b
+        bra     $-6
+        bra     CPDONE
+
+;*******************************************************************************
+; Find the pattern in the block, one candidate offset per step. The byte
+; search only tries even nibble offsets. The result is the nibble offset of
+; the first match, or FFh.
+;*******************************************************************************
+CPFIND:
+        lfsr    0,MIOFILE+mrPLEN
+        rcall   MIOGET
+        movwf   CPJ,b               ; Pattern length
+        addwf   CPIDX,w,b
+        movwf   CPS,b               ; End of this candidate
+        bc      CPFNON              ; Pattern longer than any block
+        lfsr    0,MIOFILE+mrLEN
+        rcall   MIOGET
+        cpfsgt  CPS,b               ; Skip if it runs past the block
+        bra     CPFCMP
+CPFNON:
+        movlw   0xff                ; Not found
+        bra     CPFRES
+CPFCMP:
+        lfsr    0,MIOFILE+mrA
+        lfsr    1,MIOFILE+mrBLK
+        movf    CPIDX,w,b
+        addwf   FSR1L,f,c
+        movf    CPJ,f,b
+        bz      CPFHIT              ; An empty pattern matches at once
+CPFLP:
+        movf    POSTINC1,w,c
+        cpfseq  POSTINC0,c          ; Skip while the nibbles agree
+        bra     CPFNXT
+        decfsz  CPJ,f,b
+        bra     CPFLP
+CPFHIT:
+        movf    CPIDX,w,b
+CPFRES:
+        lfsr    0,MIOFILE+mrRES
+        rcall   MIOPUT
+        bra     CPDONE
+CPFNXT:
+        incf    CPIDX,f,b
+        btfsc   CPOP,2,b            ; Skip for the nibble search
+        incf    CPIDX,f,b
+        bra     CPSAVE
+
+;*******************************************************************************
+; Multiply the 12 digit BCD mantissas A and B, one product digit per step.
+; Column k sums A[i] * B[k-i] and the carry from column k-1.
+;*******************************************************************************
+CPMUL:
+        movff   CPACC,CPS           ; Column sum starts with the carry
+        clrf    CPS+1,b
+        movff   CPIDX,CPJ           ; j = k - i
+        lfsr    0,MIOFILE+mrA
+        lfsr    1,MIOFILE+mrBLK
+        movlw   12
+        movwf   TEMP,c
+CPMULP:
+        movlw   12
+        cpfslt  CPJ,b               ; Skip if B[j] is a digit of B
+        bra     CPMULN
+        movf    CPJ,w,b
+        movf    PLUSW1,w,c
+        mulwf   INDF0,c             ; A[i] * B[j]
+        movf    PRODL,w,c
+        addwf   CPS,f,b
+        movlw   0x00
+        addwfc  CPS+1,f,b
+CPMULN:
+        movf    POSTINC0,w,c        ; Next digit of A
+        decf    CPJ,f,b
+        decfsz  TEMP,f,c
+        bra     CPMULP
+        rcall   DIV10
+        lfsr    1,MIOFILE+mrPROD
+        movf    CPIDX,w,b
+        addwf   FSR1L,f,c
+        movff   CPREM,INDF1         ; Product digit
+        movff   CPS,CPACC           ; Carry into the next column
+        incf    CPIDX,f,b
+        movlw   24
+        cpfslt  CPIDX,b             ; Skip until all 24 digits are done
+        bra     CPDONE
+        bra     CPSAVE
+
+;*******************************************************************************
+; Divide the 12 digit BCD mantissa A by B, 13 quotient digits from 10^12
+; down. R is kept packed in CPACC+6..0 and one step subtracts B once by
+; adding its nine's complement plus one. A step that borrows discards the
+; subtraction, emits the quotient digit and shifts R up one digit.
+;*******************************************************************************
+CPDIV:
+        bsf     CARRY               ; R - B = R + B' + 1
+        lfsr    0,CPACC
+        lfsr    1,CPBC
+        movlw   7
+        movwf   CPJ,b
+CPDVLP:
+        movf    POSTINC1,w,c
+        addwfc  INDF0,w,c
+        daw
+        movwf   POSTINC0,c
+        decfsz  CPJ,f,b
+        bra     CPDVLP
+        bnc     CPDVDG              ; R < B, this digit is done
+        incf    CPQ,f,b
+        movlw   10
+        cpfslt  CPQ,b               ; Skip below ten
+        bra     CPERR               ; Zero divisor or not normalized
+        bra     CPSAVE
+CPDVDG:
+        rcall   CPLOAD              ; Back to R before the subtraction
+        lfsr    1,MIOFILE+mrPROD
+        movf    CPIDX,w,b
+        addwf   FSR1L,f,c
+        movff   CPQ,INDF1           ; Quotient digit
+        movf    CPIDX,f,b
+        bz      CPDONE              ; After the last digit
+        decf    CPIDX,f,b
+        clrf    CPQ,b
+        movlw   4
+        movwf   CPJ,b
+CPDVSH:
+        lfsr    0,CPACC             ; R = R * 10
+        bcf     CARRY
+        movlw   7
+        movwf   TEMP,c
+        rlcf    POSTINC0,f,c
+        decfsz  TEMP,f,c
+        bra     $-4
+        decfsz  CPJ,f,b
+        bra     CPDVSH
+        bra     CPSAVE
+
+;*******************************************************************************
+; End the request with status 0, or with the status in WREG. The finished
+; state is committed before the opcode is cleared for the 71B.
+;*******************************************************************************
+CPERR:
+        movlw   0x01
+        bra     CPEND
+CPDONE:
+        movlw   0x00
+CPEND:
+        movff   WREG,MIOFILE+mrCST
+        clrf    CPOP,b
+        rcall   CPSAVE
+        movff   CPOP,MIOFILE+mrOP   ; Result is ready, opcode 0
+        return
+
+;*******************************************************************************
+; Load the committed state into CPWORK
+;*******************************************************************************
+CPLOAD:
+        lfsr    0,CPSTA
+        btfsc   CPSEL,0,b
+        lfsr    0,CPSTA+CPLEN
+        lfsr    1,CPWORK
+        bra     CPCOPY
+
+;*******************************************************************************
+; Commit CPWORK to the other copy of the state
+;*******************************************************************************
+CPSAVE:
+        lfsr    0,CPWORK
+        lfsr    1,CPSTA
+        btfss   CPSEL,0,b
+        lfsr    1,CPSTA+CPLEN
+        rcall   CPCOPY
+        btg     CPSEL,0,b           ; Commit
+        return
+
+CPCOPY:
+        movlw   CPLEN
+        movwf   TEMP,c
+        movff   POSTINC0,POSTINC1
+        decfsz  TEMP,f,c
+        bra     $-6
+        return
+
+;*******************************************************************************
+; Divide CPS by ten, remainder left in CPREM
+;*******************************************************************************
+DIV10:
+        clrf    CPREM,b
+        movlw   16
+        movwf   TEMP,c
+DV10LP:
+        bcf     CARRY
+        rlcf    CPS,f,b
+        rlcf    CPS+1,f,b
+        rlcf    CPREM,f,b
+        movlw   10
+        subwf   CPREM,w,b           ; Carry set when CPREM >= 10
+        bnc     $+6
+        movwf   CPREM,b
+        bsf     CPS,0,b
+        decfsz  TEMP,f,c
+        bra     DV10LP
+        return
+#endif
+
+#ifdef  BRIDGE
+;*******************************************************************************
+; SERIAL BRIDGE
+; Called by the Idle task on every pass. While the 71B has the bridge turned
+; on, move at most one byte on each leg: UART to RX ring to RX FIFO, and TX
+; FIFO to TX ring to UART, then drive IRQ14. Returns with Z clear when the
+; bridge owns the serial port, Z set otherwise, always while Din is low.
+; Only the PIC writes RXIN/RXOUT/TXIN/TXOUT and the FIFO registers mbRXH and
+; mbTXT, so a pass cut short by CDn is simply run again. A move between a
+; ring and a FIFO commits on the MMIO register write, and the ring index is
+; caught up from it at the start of the next pass. A byte read from or
+; written to the UART is counted with GIEH off for two instructions.
+;*******************************************************************************
+BRGSVC:
+        movff   MIOFILE+mbCTL,WREG
+        btfss   SIGPORT,Din,c       ; 71B turned off, the monitor has the port
+        movlw   0x00
+        andlw   0x01
+        bnz     BRGRUN
+        bsf     SIGTRIS,IRQ14,c     ; Release IRQ14
+        return
+BRGRUN:
+        banksel RC1STA
+        btfss   RC1STA,RC1STA_OERR_POSN,b       ; Overrun error?
+        bra     $+6
+        bcf     RC1STA,RC1STA_SPEN_POSN,b       ; Disable serial port to clear error
+        bsf     RC1STA,RC1STA_SPEN_POSN,b       ; Reenable serial port
+        banksel PIR3
+        btfss   RC1IF               ; Receive Interrupt bit set?
+        bra     BRGTX
+        banksel CMD
+        incf    RXIN,w,b
+        cpfseq  RXOUT,b             ; Skip if the RX ring is full
+        bra     $+8
+        movff   RC1REG,WREG         ; Drop the byte
+        bra     BRGTX
+        lfsr    1,RXRING
+        movff   RXIN,FSR1L
+        bcf     GIEH
+        movff   RC1REG,INDF1
+        incf    RXIN,f,b
+        bsf     GIEH
+BRGTX:
+        banksel CMD
+        movf    TXOUT,w,b
+        cpfseq  TXIN,b              ; Skip if the TX ring is empty
+        bra     $+4
+        bra     BRGRXF
+        banksel PIR3
+        btfss   TX1IF               ; Skip if the transmit buffer is empty
+        bra     BRGRXF
+        banksel CMD
+        lfsr    1,TXRING
+        movff   TXOUT,FSR1L
+        bcf     GIEH
+        movff   INDF1,TX1REG
+        incf    TXOUT,f,b
+        bsf     GIEH
+BRGRXF:
+        ; RX ring to RX FIFO, slot RXOUT mod 16
+        banksel CMD
+        movff   MIOFILE+mbRXH,WREG
+        xorwf   RXOUT,w,b
+        andlw   0x0f
+        bz      $+4
+        incf    RXOUT,f,b           ; mbRXH was already advanced
+        movf    RXOUT,w,b
+        cpfseq  RXIN,b              ; Skip if the RX ring is empty
+        bra     $+4
+        bra     BRGTXF
+        movff   MIOFILE+mbRXT,TEMP
+        incf    RXOUT,w,b
+        andlw   0x0f
+        cpfseq  TEMP,c              ; Skip if the RX FIFO is full
+        bra     $+4
+        bra     BRGTXF
+        lfsr    0,MIOFILE+mbRXF
+        rlncf   RXOUT,w,b
+        andlw   0x1e
+        addwf   FSR0L,f,c
+        lfsr    1,RXRING
+        movff   RXOUT,FSR1L
+        movf    INDF1,w,c
+        rcall   MIOPUT
+        incf    RXOUT,w,b
+        andlw   0x0f
+        movff   WREG,MIOFILE+mbRXH  ; Commit, the 71B can read it now
+        incf    RXOUT,f,b
+BRGTXF:
+        ; TX FIFO to TX ring, slot TXIN mod 16
+        movff   MIOFILE+mbTXT,WREG
+        xorwf   TXIN,w,b
+        andlw   0x0f
+        bz      $+4
+        incf    TXIN,f,b            ; mbTXT was already advanced
+        incf    TXIN,w,b
+        cpfseq  TXOUT,b             ; Skip if the TX ring is full
+        bra     $+4
+        bra     BRGCNT
+        movff   MIOFILE+mbTXH,WREG
+        xorwf   TXIN,w,b
+        andlw   0x0f
+        bz      BRGCNT              ; TX FIFO is empty
+        lfsr    0,MIOFILE+mbTXF
+        rlncf   TXIN,w,b
+        andlw   0x1e
+        addwf   FSR0L,f,c
+        rcall   MIOGET
+        lfsr    1,TXRING
+        movff   TXIN,FSR1L
+        movwf   INDF1,c
+        incf    TXIN,w,b
+        andlw   0x0f
+        movff   WREG,MIOFILE+mbTXT  ; Commit, the 71B can reuse the slot
+        incf    TXIN,f,b
+BRGCNT:
+        lfsr    0,MIOFILE+mbRXN
+        movf    RXOUT,w,b
+        subwf   RXIN,w,b
+        rcall   MIOPUT              ; Bytes waiting behind the RX FIFO
+        movf    TXOUT,w,b
+        subwf   TXIN,w,b
+        rcall   MIOPUT              ; Bytes still to be sent
+        ; IRQ14 while the RX FIFO holds data, if the 71B enabled it
+        movff   MIOFILE+mbRXH,TEMP
+        movff   MIOFILE+mbRXT,WREG
+        xorwf   TEMP,w,c
+        bz      BRGNIQ
+        movff   MIOFILE+mbCTL,WREG
+        btfss   WREG,1,c            ; Skip if IRQ14 is enabled
+        bra     BRGNIQ
+        bsf     SIGLAT,IRQ14,c      ; Assert IRQ14
+        bcf     SIGTRIS,IRQ14,c
+        bra     $+4
+BRGNIQ:
+        bsf     SIGTRIS,IRQ14,c     ; Release IRQ14
+        iorlw   0x01                ; Z clear, the bridge owns the port
+        return
+#endif
+
 ;*******************************************************************************
 ; SERIAL MONITOR
 ; The serial monitor provides a way to easily modify a ROM configuration and
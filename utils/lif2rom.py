@@ -0,0 +1,182 @@
+""" Pack HP-71B LEX files from LIF volumes into MultiMod ROM images """
+import sys
+
+CHIP = 32768                # Nibbles in a 16K chip
+HALF = 16384                # Nibbles in an 8K half chip
+HEAD = 37                   # Nibbles in a file header
+ROMID = [0x3b, 0xdd, 0xdd, 0xed]    # Module header, as in joesbest.dat
+TYPES = {0xe208: 'LEX', 0xe214: 'BASIC', 0xe204: 'BIN'}
+
+# Read the directory of a LIF volume. The volume header gives the start and
+# length of the directory in 256 byte sectors. Each 32 byte entry holds the
+# name, the file type, the start and length in sectors, the date in BCD, and
+# for an HP-71B file its length in nibbles, low byte first. Type 0 is a
+# purged file and FFFFh ends the directory.
+def readlif(name):
+    vol = open(name, 'rb').read()
+    if vol[0:2] != b'\x80\x00':
+        sys.exit('lif2rom: {0} is not a LIF volume'.format(name))
+    start = int.from_bytes(vol[8:12], 'big')
+    count = int.from_bytes(vol[16:20], 'big')
+    files = []
+    for i in range(count * 8):
+        entry = vol[start * 256 + i * 32:start * 256 + i * 32 + 32]
+        ftype = int.from_bytes(entry[10:12], 'big')
+        if ftype == 0xffff:
+            break
+        if ftype == 0:
+            continue
+        first = int.from_bytes(entry[12:16], 'big') * 256
+        nibs = int.from_bytes(entry[28:31], 'little')
+        files.append({'name': entry[0:10].decode('ascii', 'replace'),
+                      'type': ftype, 'date': entry[20:26], 'nibs': nibs,
+                      'data': vol[first:first + (nibs + 1) // 2]})
+    return files
+
+# Split bytes into nibbles, low nibble first as the 71B stores them
+def nibbles(data):
+    out = []
+    for byte in data:
+        out.append(byte & 0x0f)
+        out.append(byte >> 4)
+    return out
+
+# Append a value to a nibble list, low nibble first
+def putval(out, value, count):
+    for i in range(count):
+        out.append((value >> (4 * i)) & 0x0f)
+
+# Build the file chain entry of a file, a 37 nibble header and its body.
+# The header holds the name in 8 characters, the type, flags and copy code,
+# the date as minute, hour, day, month and year in BCD, and the length of
+# the body plus the five nibbles of the length field itself.
+def chainfile(f):
+    out = []
+    for ch in f['name'][0:8].ljust(8).encode('ascii'):
+        putval(out, ch, 2)
+    putval(out, f['type'], 4)
+    putval(out, 0, 2)
+    date = f['date']
+    for i in (4, 3, 2, 1, 0):
+        putval(out, date[i], 2)
+    putval(out, f['nibs'] + 5, 5)
+    return out + nibbles(f['data'])[0:f['nibs']]
+
+# Build a ROM image of a given size in nibbles, the module header followed
+# by the file chain, and zeros after the last file end the chain.
+def romimage(entries, size):
+    out = nibbles(bytes(ROMID))
+    for entry in entries:
+        out = out + entry
+    out = out + [0] * (size - len(out))
+    return bytes(out[i] | (out[i + 1] << 4) for i in range(0, size, 2))
+
+# Write an image as a DAT file for the IMAGE command, in the format written
+# by bin2dat.py, 64 bytes per line ending with a carriage return.
+def writedat(name, data):
+    out = open(name, 'w', newline='')
+    for i in range(0, len(data), 64):
+        out.write(data[i:i + 64].hex().upper() + '\r')
+    out.write('\r')
+    out.close()
+
+def usage():
+    sys.stderr.write('usage: python3 lif2rom.py [-half] [-o PREFIX] '
+                     '[-f NAME ...] FILE.lif ...\n')
+    sys.exit(1)
+
+# Main function
+# Without -f every LEX file of the volumes that fits in a chip is packed,
+# with -f the files named, of any type in TYPES. A file found in two volumes
+# is packed once. Files are packed into the fewest chips first fit, largest
+# first, and keep their order within a chip. Room is left for the module
+# header and for a zero header after the last file. A chip that would fit in
+# 8K is written as an 8K image, with -half every image is.
+# Without -o the directories and the packing are listed only.
+def main():
+    args = sys.argv[1:]
+    size = CHIP
+    prefix = None
+    names = []
+    volumes = []
+    while args:
+        arg = args.pop(0)
+        if arg == '-half':
+            size = HALF
+        elif arg == '-o' and args:
+            prefix = args.pop(0)
+        elif arg == '-f' and args:
+            names.append(args.pop(0).upper())
+        elif arg.startswith('-'):
+            usage()
+        else:
+            volumes.append(arg)
+    if not volumes:
+        usage()
+
+    room = size - len(ROMID) * 2 - HEAD
+    files = []
+    for vol in volumes:
+        print(vol)
+        for f in readlif(vol):
+            kind = TYPES.get(f['type'], '{0:04X}'.format(f['type']))
+            print('  {0} {1:5} {2:6} nibbles'.format(f['name'], kind,
+                                                     f['nibs']))
+            name = f['name'].strip()
+            if names and name not in names:
+                continue
+            if not names and f['type'] != 0xe208:
+                continue
+            if f['type'] not in TYPES:
+                sys.exit('lif2rom: {0} is not an HP-71B file type that can '
+                         'run from ROM'.format(name))
+            if HEAD + f['nibs'] > room:
+                if names:
+                    sys.exit('lif2rom: {0} does not fit in a chip'.format(
+                        name))
+                print('    does not fit in a chip, left out')
+                continue
+            same = [g for g in files if g['name'] == f['name']]
+            if same and same[0]['data'] != f['data']:
+                sys.exit('lif2rom: two different files named {0}'.format(
+                    name))
+            if not same:
+                files.append(f)
+    for name in names:
+        if not any(f['name'].strip() == name for f in files):
+            sys.exit('lif2rom: {0} not found'.format(name))
+    if not files:
+        sys.exit('lif2rom: no files to pack')
+
+    # First fit decreasing
+    order = sorted(range(len(files)), key=lambda i: -files[i]['nibs'])
+    chips = []                  # Lists of file indexes
+    used = []
+    for i in order:
+        need = HEAD + files[i]['nibs']
+        for c in range(len(chips)):
+            if used[c] + need <= room:
+                chips[c].append(i)
+                used[c] = used[c] + need
+                break
+        else:
+            chips.append([i])
+            used.append(need)
+
+    print()
+    for c in range(len(chips)):
+        chips[c].sort()
+        csize = size
+        if used[c] <= HALF - len(ROMID) * 2 - HEAD:
+            csize = HALF
+        print('ROM {0}, {1}K, {2} of {3} nibbles used'.format(
+            c + 1, csize // 2048, used[c], csize - len(ROMID) * 2 - HEAD))
+        for i in chips[c]:
+            print('  {0}'.format(files[i]['name']))
+        if prefix is not None:
+            image = romimage([chainfile(files[i]) for i in chips[c]], csize)
+            dat = '{0}{1}.dat'.format(prefix, c + 1)
+            writedat(dat, image)
+            print('  -> {0}'.format(dat))
+
+main()
@@ -0,0 +1,173 @@
+""" Lay out a set of HP-71B ROM images in MultiMod flash blocks, keeping
+each distinct 16K chip once """
+import hashlib
+import os
+import sys
+
+CHIP = 16384                # One PFM block holds one 16K chip
+HALF = 8192                 # Each half of a block holds one 8K image
+NBLOCKS = 7                 # PFM blocks 1 to 7
+NSLOTS = 14                 # ROM table entries, the last two for a hard ROM
+NSLOTSCRUB = 12             # ROM table entries of a SCRUB build
+
+# Read a ROM image. A DAT file is ASCII hex, two characters per byte, and
+# anything that is not a hex digit is skipped. Any other file is taken as a
+# BIN file, a binary image with nibbles arranged as bytes.
+def readimage(name):
+    if name.lower().endswith('.dat'):
+        text = open(name, errors='ignore').read()
+        digits = ''.join(c for c in text if c in '0123456789abcdefABCDEF')
+        return bytes.fromhex(digits[:len(digits) // 2 * 2])
+    return open(name, 'rb').read()
+
+# Cut an image into 16K chips. An image of 8K or less is kept as one short
+# chip, anything else is padded to whole chips with zeros.
+def chips(data):
+    if len(data) <= HALF:
+        return [data + bytes(HALF - len(data))]
+    data = data + bytes(-len(data) % CHIP)
+    return [data[i:i + CHIP] for i in range(0, len(data), CHIP)]
+
+# Write a chip as a DAT file for the IMAGE command, in the format written by
+# bin2dat.py, 64 bytes per line ending with a carriage return.
+def writedat(name, data):
+    out = open(name, 'w', newline='')
+    for i in range(0, len(data), 64):
+        out.write(data[i:i + 64].hex().upper() + '\r')
+    out.write('\r')
+    out.close()
+
+def usage():
+    sys.stderr.write('usage: python3 romdedup.py [-o DIR] [-hard FILE] '
+                     '[-hidden FILE] [-scrub] FILE ...\n')
+    sys.exit(1)
+
+# Main function
+# Each distinct chip gets a block, in the order the images are given, so a
+# chip shared between images, or between two files of the same ROM, is kept
+# once. Short chips are paired in the upper and lower halves of a block,
+# each with an 8K entry. Block 0 is the hidden ROM and only takes the 8K
+# image given with -hidden, in its upper half with the first table entry. An
+# image whose chips land in consecutive blocks takes one ROM table entry of
+# its size, any other takes one entry per chip, the last one ending the
+# module. A SCRUB build has a shorter table, given with -scrub.
+def main():
+    args = sys.argv[1:]
+    outdir = None
+    hard = None
+    hidden = None
+    nslots = NSLOTS
+    while args and args[0].startswith('-'):
+        if args[0] == '-scrub':
+            nslots = NSLOTSCRUB
+            args = args[1:]
+            continue
+        if args[0] == '-o' and len(args) > 1:
+            outdir = args[1]
+        elif args[0] == '-hard' and len(args) > 1:
+            hard = args[1]
+        elif args[0] == '-hidden' and len(args) > 1:
+            hidden = args[1]
+        else:
+            usage()
+        args = args[2:]
+    if not args and hard is None and hidden is None:
+        usage()
+
+    images = [(name, chips(readimage(name))) for name in args]
+    if hard is not None:
+        images.append((hard, chips(readimage(hard))))
+        if len(images[-1][1]) != 2 or len(images[-1][1][0]) != CHIP:
+            sys.exit('romdedup: the hard ROM must be 32K, two chips')
+
+    # Assign a block, and a half for a short chip, to each distinct chip
+    blocks = {}                 # Chip hash to (block number, half)
+    layout = []                 # (block, half, image name, chip number, data)
+    if hidden is not None:
+        parts = chips(readimage(hidden))
+        if len(parts[0]) != HALF:
+            sys.exit('romdedup: the hidden ROM must be 8K or less')
+        layout.append((0, '', hidden, 1, parts[0]))
+    nextblk = 1
+    lower = None                # Block with a free lower half
+    for name, parts in images:
+        for n, data in enumerate(parts):
+            key = hashlib.sha1(data).hexdigest()
+            if key in blocks:
+                continue
+            if len(data) == HALF and lower is not None:
+                blk, half = lower, 'L'
+                lower = None
+            else:
+                blk, half = nextblk, ''
+                nextblk = nextblk + 1
+                if len(data) == HALF:
+                    half = 'U'
+                    lower = blk
+            blocks[key] = (blk, half)
+            layout.append((blk, half, name, n + 1, data))
+    if nextblk - 1 > NBLOCKS:
+        sys.exit('romdedup: {0} distinct chips need {1} blocks, only {2} '
+                 'are free'.format(len(layout), nextblk - 1, NBLOCKS))
+    layout.sort()
+
+    # Build the ROM table entries
+    sizes = {1: '1', 2: '3', 4: '6'}
+    entries = []                # (image name, size key, block)
+    if hidden is not None:
+        entries.append((hidden, '8', '0'))
+    for name, parts in images[:len(args)]:
+        if len(parts[0]) == HALF:
+            blk, half = blocks[hashlib.sha1(parts[0]).hexdigest()]
+            entries.append((name, '8', half + str(blk)))
+            continue
+        blks = [blocks[hashlib.sha1(d).hexdigest()][0] for d in parts]
+        run = blks == list(range(blks[0], blks[0] + len(blks)))
+        if run and len(blks) in sizes:
+            entries.append((name, sizes[len(blks)], str(blks[0])))
+        else:
+            for blk in blks[:-1]:
+                entries.append((name, 'c', str(blk)))
+            entries.append((name, '1', str(blks[-1])))
+    soft = nslots - (2 if hard is not None else 0)
+    if len(entries) > soft:
+        sys.exit('romdedup: {0} soft ROM entries needed, the table has '
+                 '{1}'.format(len(entries), soft))
+
+    # Report the layout and the monitor commands that load it
+    if outdir is not None:
+        os.makedirs(outdir, exist_ok=True)
+    print('Block  Image')
+    for blk, half, name, n, data in layout:
+        dat = ''
+        if outdir is not None:
+            dat = os.path.join(outdir, 'block{0}{1}.dat'.format(blk, half))
+            writedat(dat, data)
+            dat = '  -> ' + dat
+        print('  {0:2}   {1} chip {2}{3}'.format(str(blk) + half, name, n,
+                                                 dat))
+    total = sum(len(parts) for name, parts in images)
+    if hidden is not None:
+        total = total + 1
+    print('{0} chips in {1} blocks, {2} shared'.format(
+        total, len(set(entry[0] for entry in layout)), total - len(layout)))
+    print()
+    print('Monitor commands')
+    for blk, half, name, n, data in layout:
+        print('  E{0:3}I{0:3} {1} chip {2}'.format(half + str(blk), name, n))
+    for slot, (name, size, blk) in enumerate(entries):
+        print('  R{0:X}{1}{2}    {3}'.format(slot + 1, size, blk, name))
+    if hard is not None:
+        for slot in range(2):
+            blk = blocks[hashlib.sha1(images[-1][1][slot]).hexdigest()][0]
+            print('  R{0:X}c{1}    {2}'.format(soft + slot + 1, blk, hard))
+        print('  HY')
+    else:
+        print('  HN')
+    if entries:
+        print('  L{0:X}'.format(len(entries)))
+    print('  CY')
+    if hidden is not None:
+        print('Block 0 is the hidden ROM, enumerated when ROMNUM bit 1 is set')
+
+main()